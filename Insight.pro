@@ -13,37 +13,77 @@ CONFIG += debug_and_release
 SOURCES += \
     src/MainWindow.cpp \
     src/Main.cpp \
+    src/Metrics.cpp \
     src/Settings.cpp \
+    src/ThreadPool.cpp \
     src/Util.cpp \
+    src/ImageProcess/BitMask.cpp \
+    src/ImageProcess/BlobDetector.cpp \
+    src/ImageProcess/ColorFilter.cpp \
+    src/ImageProcess/ColorLut.cpp \
     src/ImageProcess/FindTarget2013.cpp \
     src/ImageProcess/FindTarget2014.cpp \
     src/ImageProcess/FindTarget2016.cpp \
     src/ImageProcess/ProcBase.cpp \
+    src/ImageProcess/TargetTracker.cpp \
+    src/ImageProcess/YCbCrFilter.cpp \
+    src/MJPEG/ChangeDetector.cpp \
     src/MJPEG/ClientBase.cpp \
+    src/MJPEG/DuplicateDetector.cpp \
+    src/MJPEG/FrameRecord.cpp \
+    src/MJPEG/JpegDecoder.cpp \
+    src/MJPEG/JpegEncoder.cpp \
     src/MJPEG/MjpegClient.cpp \
     src/MJPEG/mjpeg_sck.cpp \
     src/MJPEG/mjpeg_sck_selector.cpp \
     src/MJPEG/MjpegServer.cpp \
+    src/MJPEG/MulticastClient.cpp \
+    src/MJPEG/MulticastPacket.cpp \
+    src/MJPEG/MulticastSender.cpp \
+    src/MJPEG/RateController.cpp \
+    src/MJPEG/RecordClient.cpp \
     src/MJPEG/VideoStream.cpp \
     src/MJPEG/WebcamClient.cpp \
+    src/MJPEG/WebSocket.cpp \
     src/MJPEG/WpiClient.cpp \
     src/MJPEG/win32_socketpair.c
 
 HEADERS  += \
     src/MainWindow.hpp \
+    src/Metrics.hpp \
     src/Settings.hpp \
+    src/ThreadPool.hpp \
     src/Util.hpp \
+    src/ImageProcess/BitMask.hpp \
+    src/ImageProcess/BlobDetector.hpp \
+    src/ImageProcess/ColorFilter.hpp \
+    src/ImageProcess/ColorLut.hpp \
     src/ImageProcess/FindTarget2013.hpp \
     src/ImageProcess/FindTarget2014.hpp \
     src/ImageProcess/FindTarget2016.hpp \
     src/ImageProcess/ProcBase.hpp \
+    src/ImageProcess/TargetTracker.hpp \
+    src/ImageProcess/YCbCrFilter.hpp \
+    src/MJPEG/CandidateFinder.hpp \
+    src/MJPEG/ChangeDetector.hpp \
     src/MJPEG/ClientBase.hpp \
+    src/MJPEG/DuplicateDetector.hpp \
+    src/MJPEG/FrameRecord.hpp \
+    src/MJPEG/JpegDecoder.hpp \
+    src/MJPEG/JpegEncoder.hpp \
     src/MJPEG/MjpegClient.hpp \
     src/MJPEG/mjpeg_sck.hpp \
     src/MJPEG/mjpeg_sck_selector.hpp \
     src/MJPEG/MjpegServer.hpp \
+    src/MJPEG/MulticastClient.hpp \
+    src/MJPEG/MulticastPacket.hpp \
+    src/MJPEG/MulticastSender.hpp \
+    src/MJPEG/RateController.hpp \
+    src/MJPEG/RecordClient.hpp \
+    src/MJPEG/ScanlineSink.hpp \
     src/MJPEG/VideoStream.hpp \
     src/MJPEG/WebcamClient.hpp \
+    src/MJPEG/WebSocket.hpp \
     src/MJPEG/WpiClient.hpp \
     src/MJPEG/win32_socketpair.h \
     src/MJPEG/WindowCallbacks.hpp
@@ -55,3 +95,11 @@ DISTFILES += \
     Resources.rc
 
 LIBS += -ljpeg -lopencv_core -lopencv_imgcodecs -lopencv_imgproc -lopencv_videoio
+
+# Build with "qmake CONFIG+=h264" to serve an H.264 stream as well
+h264 {
+    DEFINES += INSIGHT_WITH_H264
+    SOURCES += src/MJPEG/H264Encoder.cpp
+    HEADERS += src/MJPEG/H264Encoder.hpp
+    LIBS += -lavcodec -lavutil -lswscale
+}
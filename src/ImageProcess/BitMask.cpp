@@ -0,0 +1,351 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#include "BitMask.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define INSIGHT_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+/* The 3x3 morphology is separable, so each pass first combines every pixel
+ * with its left and right neighbors, then each row with the rows above and
+ * below it. Like OpenCV's default border, pixels outside the image never
+ * erode or dilate the pixels inside it.
+ */
+
+// Combines each word of a row with its horizontal neighbors
+typedef void (*MorphRowFunc)(const uint64_t* in, uint64_t* out, int words,
+                             uint64_t lastMask);
+
+// Combines three rows. Missing rows at the image's edges are passed as 'row'.
+typedef void (*CombineRowsFunc)(const uint64_t* above, const uint64_t* row,
+                                const uint64_t* below, uint64_t* out,
+                                int words);
+
+template <bool erode>
+inline uint64_t combine(uint64_t a, uint64_t b, uint64_t c) {
+    return erode ? a & b & c : a | b | c;
+}
+
+template <bool erode>
+inline uint64_t morphWord(const uint64_t* in, int i, int words,
+                          uint64_t lastMask) {
+    // Pixels outside the image have the value which leaves the others alone
+    constexpr uint64_t fill = erode ? ~uint64_t{0} : 0;
+
+    uint64_t prev = i > 0 ? in[i - 1] : fill;
+    uint64_t cur = in[i];
+    uint64_t next = i + 1 < words ? in[i + 1] : fill;
+
+    // Padding bits past the end of the row are outside the image too
+    if (i + 1 == words) {
+        cur |= fill & ~lastMask;
+    } else if (i + 2 == words) {
+        next |= fill & ~lastMask;
+    }
+
+    uint64_t left = (cur << 1) | (prev >> 63);
+    uint64_t right = (cur >> 1) | (next << 63);
+    uint64_t result = combine<erode>(cur, left, right);
+    return i + 1 == words ? result & lastMask : result;
+}
+
+template <bool erode>
+void morphRowScalar(const uint64_t* in, uint64_t* out, int words,
+                    uint64_t lastMask) {
+    for (int i = 0; i < words; i++) {
+        out[i] = morphWord<erode>(in, i, words, lastMask);
+    }
+}
+
+template <bool erode>
+void combineRowsScalar(const uint64_t* above, const uint64_t* row,
+                       const uint64_t* below, uint64_t* out, int words) {
+    for (int i = 0; i < words; i++) {
+        out[i] = combine<erode>(above[i], row[i], below[i]);
+    }
+}
+
+#ifdef INSIGHT_X86
+template <bool erode>
+__attribute__((target("avx2"))) inline __m256i combineAvx2(__m256i a,
+                                                            __m256i b,
+                                                            __m256i c) {
+    return erode ? _mm256_and_si256(_mm256_and_si256(a, b), c)
+                 : _mm256_or_si256(_mm256_or_si256(a, b), c);
+}
+
+/* The neighbors of four words are read with unaligned loads one word before
+ * and after them, so the bits shifted in across word boundaries come from
+ * 64-bit lane shifts instead of cross-lane permutes. The first and last words
+ * need the image's border and are handled by the scalar code.
+ */
+template <bool erode>
+__attribute__((target("avx2"))) void morphRowAvx2(const uint64_t* in,
+                                                  uint64_t* out, int words,
+                                                  uint64_t lastMask) {
+    int i = 1;
+    for (; i + 4 < words; i += 4) {
+        __m256i prev = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(in + i - 1));
+        __m256i cur =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        __m256i next = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(in + i + 1));
+
+        __m256i left = _mm256_or_si256(_mm256_slli_epi64(cur, 1),
+                                       _mm256_srli_epi64(prev, 63));
+        __m256i right = _mm256_or_si256(_mm256_srli_epi64(cur, 1),
+                                        _mm256_slli_epi64(next, 63));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                            combineAvx2<erode>(cur, left, right));
+    }
+
+    out[0] = morphWord<erode>(in, 0, words, lastMask);
+    for (; i < words; i++) {
+        out[i] = morphWord<erode>(in, i, words, lastMask);
+    }
+}
+
+template <bool erode>
+__attribute__((target("avx2"))) void combineRowsAvx2(const uint64_t* above,
+                                                     const uint64_t* row,
+                                                     const uint64_t* below,
+                                                     uint64_t* out,
+                                                     int words) {
+    int i = 0;
+    for (; i + 4 <= words; i += 4) {
+        __m256i a =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(above + i));
+        __m256i b =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+        __m256i c =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(below + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                            combineAvx2<erode>(a, b, c));
+    }
+
+    for (; i < words; i++) {
+        out[i] = combine<erode>(above[i], row[i], below[i]);
+    }
+}
+#endif
+
+struct Implementation {
+    const char* name;
+    MorphRowFunc erodeRow;
+    MorphRowFunc dilateRow;
+    CombineRowsFunc erodeRows;
+    CombineRowsFunc dilateRows;
+};
+
+Implementation selectImplementation() {
+#ifdef INSIGHT_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return {"AVX2", morphRowAvx2<true>, morphRowAvx2<false>,
+                combineRowsAvx2<true>, combineRowsAvx2<false>};
+    }
+#endif
+    return {"scalar", morphRowScalar<true>, morphRowScalar<false>,
+            combineRowsScalar<true>, combineRowsScalar<false>};
+}
+
+const Implementation& getImplementation() {
+    static Implementation implementation = selectImplementation();
+    return implementation;
+}
+
+// Eight bytes of 0 or 255 for each value of a byte of packed pixels
+struct UnpackTable {
+    uint64_t bytes[256];
+
+    UnpackTable() {
+        for (int value = 0; value < 256; value++) {
+            uint8_t pixels[8];
+            for (int bit = 0; bit < 8; bit++) {
+                pixels[bit] = (value >> bit) & 1 ? 255 : 0;
+            }
+            std::memcpy(&bytes[value], pixels, sizeof(pixels));
+        }
+    }
+};
+
+}  // namespace
+
+BitMask::BitMask(int width, int height) { create(width, height); }
+
+void BitMask::create(int width, int height) {
+    m_width = width;
+    m_height = height;
+    m_stride = (width + 63) / 64;
+    m_lastMask =
+        width % 64 == 0 ? ~uint64_t{0} : (uint64_t{1} << width % 64) - 1;
+    m_words.assign(m_stride * height, 0);
+}
+
+int BitMask::getWidth() const { return m_width; }
+
+int BitMask::getHeight() const { return m_height; }
+
+bool BitMask::get(int x, int y) const {
+    return (getRow(y)[x / 64] >> (x % 64)) & 1;
+}
+
+void BitMask::set(int x, int y, bool value) {
+    uint64_t bit = uint64_t{1} << (x % 64);
+    if (value) {
+        getRow(y)[x / 64] |= bit;
+    } else {
+        getRow(y)[x / 64] &= ~bit;
+    }
+}
+
+void BitMask::clear() { std::fill(m_words.begin(), m_words.end(), 0); }
+
+void BitMask::fromMat(const cv::Mat& image) {
+    if (image.cols != m_width || image.rows != m_height) {
+        create(image.cols, image.rows);
+    }
+
+    for (int y = 0; y < m_height; y++) {
+        const uint8_t* in = image.ptr<uint8_t>(y);
+        uint64_t* out = getRow(y);
+
+        int x = 0;
+#ifdef INSIGHT_X86
+        // Gather the inverted "is zero" bit of 16 pixels at a time
+        const __m128i zero = _mm_setzero_si128();
+        for (; x + 64 <= m_width; x += 64) {
+            uint64_t word = 0;
+            for (int i = 0; i < 4; i++) {
+                __m128i pixels = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(in + x + 16 * i));
+                uint64_t isZero = static_cast<uint16_t>(
+                    _mm_movemask_epi8(_mm_cmpeq_epi8(pixels, zero)));
+                word |= (~isZero & 0xFFFF) << (16 * i);
+            }
+            out[x / 64] = word;
+        }
+#endif
+        for (; x < m_width; x += 64) {
+            uint64_t word = 0;
+            for (int i = 0; i < 64 && x + i < m_width; i++) {
+                word |= static_cast<uint64_t>(in[x + i] != 0) << i;
+            }
+            out[x / 64] = word;
+        }
+    }
+}
+
+void BitMask::toMat(cv::Mat& image) const {
+    static const UnpackTable table;
+
+    image.create(m_height, m_width, CV_8UC1);
+    for (int y = 0; y < m_height; y++) {
+        const uint8_t* in = reinterpret_cast<const uint8_t*>(getRow(y));
+        uint8_t* out = image.ptr<uint8_t>(y);
+
+        // Words are little-endian on every platform Insight runs on
+        int x = 0;
+        for (; x + 8 <= m_width; x += 8) {
+            std::memcpy(out + x, &table.bytes[in[x / 8]], 8);
+        }
+        for (; x < m_width; x++) {
+            out[x] = (in[x / 8] >> (x % 8)) & 1 ? 255 : 0;
+        }
+    }
+}
+
+void BitMask::erode(int iterations) { morph<true>(iterations); }
+
+void BitMask::dilate(int iterations) { morph<false>(iterations); }
+
+void BitMask::open(int iterations) {
+    morph<true>(iterations);
+    morph<false>(iterations);
+}
+
+void BitMask::close(int iterations) {
+    morph<false>(iterations);
+    morph<true>(iterations);
+}
+
+int BitMask::count() const {
+    int count = 0;
+    for (uint64_t word : m_words) {
+        count += __builtin_popcountll(word);
+    }
+    return count;
+}
+
+void BitMask::getSpans(std::vector<Span>& spans) const {
+    spans.clear();
+
+    for (int y = 0; y < m_height; y++) {
+        const uint64_t* row = getRow(y);
+
+        /* Set bits of 'edges' are where a run starts or ends, found by
+         * comparing each pixel with the one to its left
+         */
+        uint64_t carry = 0;
+        int begin = -1;
+        for (int i = 0; i < m_stride; i++) {
+            uint64_t edges = row[i] ^ ((row[i] << 1) | carry);
+            carry = row[i] >> 63;
+
+            while (edges != 0) {
+                int x = 64 * i + __builtin_ctzll(edges);
+                edges &= edges - 1;
+
+                if (begin < 0) {
+                    begin = x;
+                } else {
+                    spans.push_back({y, begin, x});
+                    begin = -1;
+                }
+            }
+        }
+
+        if (begin >= 0) {
+            spans.push_back({y, begin, m_width});
+        }
+    }
+}
+
+uint64_t* BitMask::getRow(int y) { return &m_words[y * m_stride]; }
+
+const uint64_t* BitMask::getRow(int y) const {
+    return &m_words[y * m_stride];
+}
+
+const char* BitMask::getInstructionSet() { return getImplementation().name; }
+
+template <bool erode>
+void BitMask::morph(int iterations) {
+    const Implementation& implementation = getImplementation();
+    MorphRowFunc morphRow =
+        erode ? implementation.erodeRow : implementation.dilateRow;
+    CombineRowsFunc combineRows =
+        erode ? implementation.erodeRows : implementation.dilateRows;
+
+    m_scratch.resize(m_words.size());
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        for (int y = 0; y < m_height; y++) {
+            morphRow(getRow(y), &m_scratch[y * m_stride], m_stride,
+                     m_lastMask);
+        }
+
+        for (int y = 0; y < m_height; y++) {
+            const uint64_t* row = &m_scratch[y * m_stride];
+            const uint64_t* above = y > 0 ? row - m_stride : row;
+            const uint64_t* below = y + 1 < m_height ? row + m_stride : row;
+            combineRows(above, row, below, getRow(y), m_stride);
+        }
+    }
+}
@@ -0,0 +1,88 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+/**
+ * A binary image which stores one bit per pixel
+ *
+ * Each row is packed into 64-bit words with pixel x in bit (x % 64) of word
+ * (x / 64). Morphology works on whole words, so a 3x3 erode or dilate of 64
+ * pixels (256 with AVX2) takes a handful of shifts and ANDs or ORs, and
+ * moves an eighth of the memory a byte-per-pixel mask would. Masks are
+ * converted from and to 8-bit cv::Mats at the edges of a pipeline.
+ */
+class BitMask {
+public:
+    // A run of set pixels in one row, from 'begin' up to but excluding 'end'
+    struct Span {
+        int y;
+        int begin;
+        int end;
+    };
+
+    BitMask() = default;
+    BitMask(int width, int height);
+
+    // Resizes the mask and clears every pixel
+    void create(int width, int height);
+
+    int getWidth() const;
+    int getHeight() const;
+
+    bool get(int x, int y) const;
+    void set(int x, int y, bool value);
+
+    void clear();
+
+    // Sets pixels where a CV_8UC1 image is nonzero
+    void fromMat(const cv::Mat& image);
+
+    // Writes the mask into a CV_8UC1 image as 255 for set pixels and 0 else
+    void toMat(cv::Mat& image) const;
+
+    /* 3x3 morphology with the same results as cv::erode(), cv::dilate(), and
+     * cv::morphologyEx() with the default kernel and border. Opening erodes
+     * 'iterations' times and then dilates as many times; closing does the
+     * reverse.
+     */
+    void erode(int iterations = 1);
+    void dilate(int iterations = 1);
+    void open(int iterations = 1);
+    void close(int iterations = 1);
+
+    // Returns the number of set pixels
+    int count() const;
+
+    // Replaces 'spans' with the runs of set pixels in row-major order
+    void getSpans(std::vector<Span>& spans) const;
+
+    uint64_t* getRow(int y);
+    const uint64_t* getRow(int y) const;
+
+    // Returns the name of the instruction set the morphology uses
+    static const char* getInstructionSet();
+
+private:
+    int m_width = 0;
+    int m_height = 0;
+
+    // Words per row
+    int m_stride = 0;
+
+    // Valid bits of each row's last word. The others are always zero.
+    uint64_t m_lastMask = 0;
+
+    std::vector<uint64_t> m_words;
+
+    // Rows after the horizontal pass of the morphology
+    std::vector<uint64_t> m_scratch;
+
+    template <bool erode>
+    void morph(int iterations);
+};
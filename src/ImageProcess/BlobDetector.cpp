@@ -0,0 +1,198 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#include "BlobDetector.hpp"
+
+#include <algorithm>
+
+constexpr int BlobDetector::k_minStripRows;
+
+BlobDetector::BlobDetector(unsigned int numThreads) {
+    m_pool = std::make_unique<ThreadPool>(numThreads);
+    m_strips.resize(m_pool->size());
+}
+
+const std::vector<Blob>& BlobDetector::detect(const cv::Mat& mask) {
+    m_blobs.clear();
+    if (mask.rows == 0 || mask.cols == 0) {
+        return m_blobs;
+    }
+
+    m_labels.resize(mask.rows * mask.cols);
+
+    // Split the rows evenly between the strips
+    int numStrips = std::max(
+        std::min<int>(m_strips.size(), mask.rows / k_minStripRows), 1);
+    for (int i = 0; i < numStrips; i++) {
+        m_strips[i].begin = mask.rows * i / numStrips;
+        m_strips[i].end = mask.rows * (i + 1) / numStrips;
+    }
+
+    m_pool->parallelFor(numStrips, [&](unsigned int i) {
+        labelStrip(mask, m_strips[i]);
+    });
+
+    /* ===== Merge the strips ===== */
+    // Offset each strip's labels into one label space
+    m_parent.resize(1);
+    m_stats.resize(1);
+    for (int i = 0; i < numStrips; i++) {
+        auto& strip = m_strips[i];
+        strip.offset = m_parent.size() - 1;
+        for (size_t label = 1; label < strip.parent.size(); label++) {
+            m_parent.emplace_back(strip.parent[label] + strip.offset);
+        }
+        m_stats.insert(m_stats.end(), strip.stats.begin() + 1,
+                       strip.stats.end());
+    }
+
+    // Join labels on either side of each strip boundary
+    for (int i = 1; i < numStrips; i++) {
+        auto& strip = m_strips[i];
+        auto& stripAbove = m_strips[i - 1];
+        const int32_t* row = &m_labels[strip.begin * mask.cols];
+        const int32_t* above = row - mask.cols;
+        for (int x = 0; x < mask.cols; x++) {
+            if (row[x] == 0) {
+                continue;
+            }
+
+            int last = std::min(x + 1, mask.cols - 1);
+            for (int n = std::max(x - 1, 0); n <= last; n++) {
+                if (above[n] != 0) {
+                    merge(m_parent, row[x] + strip.offset,
+                          above[n] + stripAbove.offset);
+                }
+            }
+        }
+    }
+
+    // Sum each label's statistics into its root
+    for (size_t label = 1; label < m_parent.size(); label++) {
+        int32_t root = find(m_parent, label);
+        if (root != static_cast<int32_t>(label)) {
+            m_stats[root].add(m_stats[label]);
+        }
+    }
+    /* ============================ */
+
+    for (size_t label = 1; label < m_parent.size(); label++) {
+        if (m_parent[label] != static_cast<int32_t>(label)) {
+            continue;
+        }
+
+        auto& stats = m_stats[label];
+        Blob blob;
+        blob.area = stats.area;
+        blob.box = cv::Rect(stats.minX, stats.minY,
+                            stats.maxX - stats.minX + 1,
+                            stats.maxY - stats.minY + 1);
+        blob.centroid = cv::Point2f(
+            static_cast<float>(stats.sumX) / stats.area,
+            static_cast<float>(stats.sumY) / stats.area);
+        blob.perimeter = stats.perimeter;
+        m_blobs.emplace_back(blob);
+    }
+
+    return m_blobs;
+}
+
+void BlobDetector::Stats::add(const Stats& other) {
+    area += other.area;
+    minX = std::min(minX, other.minX);
+    minY = std::min(minY, other.minY);
+    maxX = std::max(maxX, other.maxX);
+    maxY = std::max(maxY, other.maxY);
+    sumX += other.sumX;
+    sumY += other.sumY;
+    perimeter += other.perimeter;
+}
+
+void BlobDetector::labelStrip(const cv::Mat& mask, Strip& strip) {
+    strip.parent.resize(1);
+    strip.stats.resize(1);
+
+    const int cols = mask.cols;
+    for (int y = strip.begin; y < strip.end; y++) {
+        const uint8_t* row = mask.ptr<uint8_t>(y);
+        const uint8_t* rowAbove = y > 0 ? mask.ptr<uint8_t>(y - 1) : nullptr;
+        const uint8_t* rowBelow =
+            y + 1 < mask.rows ? mask.ptr<uint8_t>(y + 1) : nullptr;
+        int32_t* labels = &m_labels[y * cols];
+
+        // The first row of a strip is joined to the strip above it later
+        const int32_t* above = y > strip.begin ? labels - cols : nullptr;
+
+        for (int x = 0; x < cols; x++) {
+            if (row[x] == 0) {
+                labels[x] = 0;
+                continue;
+            }
+
+            /* Pick a label from the neighbors which were already labeled. If
+             * the pixel above is set, the others are already joined to it.
+             * Otherwise, the left or upper left pixel may still need joining
+             * to the upper right one.
+             */
+            int32_t left = x > 0 ? labels[x - 1] : 0;
+            int32_t up = 0;
+            int32_t upLeft = 0;
+            int32_t upRight = 0;
+            if (above != nullptr) {
+                up = above[x];
+                upLeft = x > 0 ? above[x - 1] : 0;
+                upRight = x + 1 < cols ? above[x + 1] : 0;
+            }
+
+            int32_t label;
+            if (up != 0) {
+                label = up;
+            } else if (left != 0 || upLeft != 0) {
+                label = left != 0 ? left : upLeft;
+                if (upRight != 0) {
+                    merge(strip.parent, label, upRight);
+                }
+            } else if (upRight != 0) {
+                label = upRight;
+            } else {
+                label = strip.parent.size();
+                strip.parent.emplace_back(label);
+                strip.stats.emplace_back();
+            }
+            labels[x] = label;
+
+            auto& stats = strip.stats[label];
+            stats.area++;
+            stats.minX = std::min(stats.minX, x);
+            stats.minY = std::min(stats.minY, y);
+            stats.maxX = std::max(stats.maxX, x);
+            stats.maxY = std::max(stats.maxY, y);
+            stats.sumX += x;
+            stats.sumY += y;
+
+            // Pixels on the image's edge are also on the region's edge
+            if (x == 0 || row[x - 1] == 0 || x + 1 == cols ||
+                row[x + 1] == 0 || rowAbove == nullptr || rowAbove[x] == 0 ||
+                rowBelow == nullptr || rowBelow[x] == 0) {
+                stats.perimeter++;
+            }
+        }
+    }
+}
+
+int32_t BlobDetector::find(std::vector<int32_t>& parent, int32_t label) {
+    while (parent[label] != label) {
+        parent[label] = parent[parent[label]];
+        label = parent[label];
+    }
+    return label;
+}
+
+void BlobDetector::merge(std::vector<int32_t>& parent, int32_t a, int32_t b) {
+    a = find(parent, a);
+    b = find(parent, b);
+    if (a < b) {
+        parent[b] = a;
+    } else if (b < a) {
+        parent[a] = b;
+    }
+}
@@ -0,0 +1,101 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "../ThreadPool.hpp"
+
+// Statistics of one 8-connected region of a mask
+struct Blob {
+    // Number of pixels in the region
+    int area;
+
+    cv::Rect box;
+    cv::Point2f centroid;
+
+    /* Number of region pixels with a 4-connected neighbor outside the region.
+     * This approximates the length of the region's outline.
+     */
+    int perimeter;
+};
+
+/**
+ * Finds the connected regions of a binary mask in a single labeling pass
+ *
+ * The mask is split into horizontal strips which are labeled in parallel
+ * with a union-find of provisional labels. Labels which touch across strip
+ * boundaries are then merged, and each region's statistics are summed. All
+ * buffers are kept between calls, so nothing is allocated per frame once they
+ * have grown to fit the mask.
+ */
+class BlobDetector {
+public:
+    // A thread count of 0 uses one thread per hardware core
+    explicit BlobDetector(unsigned int numThreads = 0);
+
+    BlobDetector(const BlobDetector&) = delete;
+    BlobDetector& operator=(const BlobDetector&) = delete;
+
+    /* Returns the regions of nonzero pixels in a CV_8UC1 mask. The result is
+     * only valid until the next call.
+     */
+    const std::vector<Blob>& detect(const cv::Mat& mask);
+
+private:
+    // Strips shorter than this aren't worth handing to another thread
+    static constexpr int k_minStripRows = 32;
+
+    struct Stats {
+        int area = 0;
+        int minX = INT32_MAX;
+        int minY = INT32_MAX;
+        int maxX = -1;
+        int maxY = -1;
+        int64_t sumX = 0;
+        int64_t sumY = 0;
+        int perimeter = 0;
+
+        void add(const Stats& other);
+    };
+
+    /* Provisional labels of one strip. Label 0 is the background, so both
+     * vectors start with an unused entry.
+     */
+    struct Strip {
+        int begin;
+        int end;
+
+        // Offset of the strip's labels in the merged label space
+        int32_t offset;
+
+        std::vector<int32_t> parent;
+        std::vector<Stats> stats;
+    };
+
+    std::unique_ptr<ThreadPool> m_pool;
+    std::vector<Strip> m_strips;
+
+    // Provisional label of each pixel, local to the pixel's strip
+    std::vector<int32_t> m_labels;
+
+    // Labels and statistics of every strip offset into one label space
+    std::vector<int32_t> m_parent;
+    std::vector<Stats> m_stats;
+
+    std::vector<Blob> m_blobs;
+
+    // Labels the rows of one strip
+    void labelStrip(const cv::Mat& mask, Strip& strip);
+
+    // Returns the root of 'label' while halving the paths to it
+    static int32_t find(std::vector<int32_t>& parent, int32_t label);
+
+    // Merges the sets containing 'a' and 'b' under the smaller root
+    static void merge(std::vector<int32_t>& parent, int32_t a, int32_t b);
+};
@@ -0,0 +1,216 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#include "ColorFilter.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define INSIGHT_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+/* Filters one row of 'width' pixels and returns the number of pixels which
+ * passed
+ */
+typedef int (*FilterRowFunc)(const uint8_t* bgr, uint8_t* mask, int width,
+                             const uint8_t lower[3], const uint8_t upper[3]);
+
+int filterRowScalar(const uint8_t* bgr, uint8_t* mask, int width,
+                    const uint8_t lower[3], const uint8_t upper[3]) {
+    int count = 0;
+    for (int x = 0; x < width; x++, bgr += 3) {
+        bool pass = bgr[0] >= lower[0] && bgr[0] <= upper[0] &&
+                    bgr[1] >= lower[1] && bgr[1] <= upper[1] &&
+                    bgr[2] >= lower[2] && bgr[2] <= upper[2];
+        mask[x] = pass ? 255 : 0;
+        count += pass;
+    }
+    return count;
+}
+
+#ifdef INSIGHT_X86
+/* The SIMD kernels classify 16 pixels (48 bytes) per 128-bit lane at a time.
+ * Every byte is range-checked against the bound of its channel, whose pattern
+ * repeats every 3 bytes, so each of the three 16-byte registers needs its own
+ * bound vectors. The per-channel results are then gathered with byte shuffles
+ * so byte 'p' of each holds pixel p's result, and ANDed together.
+ */
+struct Tables {
+    // Bounds for the bytes of register 'r'
+    uint8_t lower[3][16];
+    uint8_t upper[3][16];
+
+    /* Shuffle which moves channel 'c' of each pixel in register 'r' to the
+     * pixel's output byte. Bytes from other registers are zeroed.
+     */
+    uint8_t shuffle[3][3][16];
+
+    Tables(const uint8_t lowerBound[3], const uint8_t upperBound[3]) {
+        for (int r = 0; r < 3; r++) {
+            for (int i = 0; i < 16; i++) {
+                lower[r][i] = lowerBound[(16 * r + i) % 3];
+                upper[r][i] = upperBound[(16 * r + i) % 3];
+            }
+        }
+
+        for (int c = 0; c < 3; c++) {
+            for (int r = 0; r < 3; r++) {
+                for (int p = 0; p < 16; p++) {
+                    int index = 3 * p + c - 16 * r;
+                    shuffle[c][r][p] = index >= 0 && index < 16 ? index : 0x80;
+                }
+            }
+        }
+    }
+};
+
+__attribute__((target("sse4.1"))) int filterRowSse4(
+    const uint8_t* bgr, uint8_t* mask, int width, const uint8_t lower[3],
+    const uint8_t upper[3]) {
+    Tables tables(lower, upper);
+
+    __m128i lo[3];
+    __m128i hi[3];
+    __m128i shuffle[3][3];
+    for (int r = 0; r < 3; r++) {
+        lo[r] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+            tables.lower[r]));
+        hi[r] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+            tables.upper[r]));
+        for (int c = 0; c < 3; c++) {
+            shuffle[c][r] = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(tables.shuffle[c][r]));
+        }
+    }
+
+    int count = 0;
+    int x = 0;
+    for (; x + 16 <= width; x += 16, bgr += 48) {
+        __m128i pass[3];
+        for (int r = 0; r < 3; r++) {
+            __m128i v =
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(bgr + 16 * r));
+            pass[r] = _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(v, lo[r]), v),
+                                    _mm_cmpeq_epi8(_mm_min_epu8(v, hi[r]), v));
+        }
+
+        __m128i result = _mm_set1_epi8(-1);
+        for (int c = 0; c < 3; c++) {
+            __m128i channel =
+                _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(pass[0],
+                                                           shuffle[c][0]),
+                                          _mm_shuffle_epi8(pass[1],
+                                                           shuffle[c][1])),
+                             _mm_shuffle_epi8(pass[2], shuffle[c][2]));
+            result = _mm_and_si128(result, channel);
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(mask + x), result);
+        count += __builtin_popcount(_mm_movemask_epi8(result));
+    }
+
+    return count + filterRowScalar(bgr, mask + x, width - x, lower, upper);
+}
+
+__attribute__((target("avx2"))) int filterRowAvx2(const uint8_t* bgr,
+                                                  uint8_t* mask, int width,
+                                                  const uint8_t lower[3],
+                                                  const uint8_t upper[3]) {
+    Tables tables(lower, upper);
+
+    // Both 128-bit lanes use the same tables since shuffles stay in a lane
+    __m256i lo[3];
+    __m256i hi[3];
+    __m256i shuffle[3][3];
+    for (int r = 0; r < 3; r++) {
+        lo[r] = _mm256_broadcastsi128_si256(_mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(tables.lower[r])));
+        hi[r] = _mm256_broadcastsi128_si256(_mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(tables.upper[r])));
+        for (int c = 0; c < 3; c++) {
+            shuffle[c][r] = _mm256_broadcastsi128_si256(_mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(tables.shuffle[c][r])));
+        }
+    }
+
+    int count = 0;
+    int x = 0;
+    for (; x + 32 <= width; x += 32, bgr += 96) {
+        /* The low lane holds the first 16 pixels and the high lane the next
+         * 16, so the result comes out in pixel order
+         */
+        __m256i pass[3];
+        for (int r = 0; r < 3; r++) {
+            __m256i v = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(bgr + 16 * r))),
+                _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(bgr + 48 + 16 * r)),
+                1);
+            pass[r] = _mm256_and_si256(
+                _mm256_cmpeq_epi8(_mm256_max_epu8(v, lo[r]), v),
+                _mm256_cmpeq_epi8(_mm256_min_epu8(v, hi[r]), v));
+        }
+
+        __m256i result = _mm256_set1_epi8(-1);
+        for (int c = 0; c < 3; c++) {
+            __m256i channel = _mm256_or_si256(
+                _mm256_or_si256(_mm256_shuffle_epi8(pass[0], shuffle[c][0]),
+                                _mm256_shuffle_epi8(pass[1], shuffle[c][1])),
+                _mm256_shuffle_epi8(pass[2], shuffle[c][2]));
+            result = _mm256_and_si256(result, channel);
+        }
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(mask + x), result);
+        count += __builtin_popcount(_mm256_movemask_epi8(result));
+    }
+
+    return count + filterRowSse4(bgr, mask + x, width - x, lower, upper);
+}
+#endif
+
+struct Implementation {
+    const char* name;
+    FilterRowFunc filterRow;
+};
+
+Implementation selectImplementation() {
+#ifdef INSIGHT_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return {"AVX2", filterRowAvx2};
+    } else if (__builtin_cpu_supports("sse4.1")) {
+        return {"SSE4.1", filterRowSse4};
+    }
+#endif
+    return {"scalar", filterRowScalar};
+}
+
+const Implementation& getImplementation() {
+    static Implementation implementation = selectImplementation();
+    return implementation;
+}
+
+}  // namespace
+
+void ColorFilter::apply(const cv::Mat& image, const uint8_t lower[3],
+                        const uint8_t upper[3], cv::Mat& mask,
+                        std::vector<int>& rowCounts) {
+    mask.create(image.rows, image.cols, CV_8UC1);
+    rowCounts.resize(image.rows);
+
+    FilterRowFunc filterRow = getImplementation().filterRow;
+    for (int y = 0; y < image.rows; y++) {
+        rowCounts[y] = filterRow(image.ptr<uint8_t>(y), mask.ptr<uint8_t>(y),
+                                 image.cols, lower, upper);
+    }
+}
+
+int ColorFilter::applyRow(const uint8_t* pixels, uint8_t* mask, int width,
+                          const uint8_t lower[3], const uint8_t upper[3]) {
+    return getImplementation().filterRow(pixels, mask, width, lower, upper);
+}
+
+const char* ColorFilter::getInstructionSet() {
+    return getImplementation().name;
+}
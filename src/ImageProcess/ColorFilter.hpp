@@ -0,0 +1,39 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+/**
+ * Filters a BGR image into a binary mask of pixels whose channels all lie
+ * within a range, like cv::inRange()
+ *
+ * Each row is read once and classified with the widest instruction set the
+ * CPU supports (AVX2, SSE4.1, or plain C++), chosen when the filter is first
+ * used. The number of pixels which passed in each row is counted in the same
+ * pass so callers can skip empty parts of the mask.
+ */
+class ColorFilter {
+public:
+    /* Sets 'mask' to 255 where every channel of 'image' is within the
+     * inclusive range [lower, upper] and 0 elsewhere. 'image' must be an
+     * 8-bit, 3-channel image; bounds are given in the image's channel order.
+     * 'rowCounts' receives the number of pixels set in each row of the mask.
+     */
+    static void apply(const cv::Mat& image, const uint8_t lower[3],
+                      const uint8_t upper[3], cv::Mat& mask,
+                      std::vector<int>& rowCounts);
+
+    /* Filters one row of 'width' 3-channel pixels into 'mask' like apply()
+     * and returns the number of pixels set
+     */
+    static int applyRow(const uint8_t* pixels, uint8_t* mask, int width,
+                        const uint8_t lower[3], const uint8_t upper[3]);
+
+    // Returns the name of the instruction set apply() uses
+    static const char* getInstructionSet();
+};
@@ -0,0 +1,132 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#include "ColorLut.hpp"
+
+#include <algorithm>
+#include <fstream>
+
+constexpr uint32_t ColorLut::k_magic;
+constexpr int ColorLut::k_bits;
+constexpr int ColorLut::k_cells;
+
+void ColorLut::clear() { m_table.fill(0); }
+
+bool ColorLut::empty() const {
+    return std::all_of(m_table.begin(), m_table.end(),
+                       [](uint32_t word) { return word == 0; });
+}
+
+void ColorLut::addColor(uint8_t blue, uint8_t green, uint8_t red,
+                        int spread) {
+    int cell[3] = {blue >> (8 - k_bits), green >> (8 - k_bits),
+                   red >> (8 - k_bits)};
+
+    for (int b = std::max(cell[0] - spread, 0);
+         b <= std::min(cell[0] + spread, k_cells - 1); b++) {
+        for (int g = std::max(cell[1] - spread, 0);
+             g <= std::min(cell[1] + spread, k_cells - 1); g++) {
+            for (int r = std::max(cell[2] - spread, 0);
+                 r <= std::min(cell[2] + spread, k_cells - 1); r++) {
+                uint32_t index = (b << (2 * k_bits)) | (g << k_bits) | r;
+                m_table[index / 32] |= 1u << (index % 32);
+            }
+        }
+    }
+}
+
+void ColorLut::addPatch(const cv::Mat& image, cv::Point center, int radius) {
+    for (int y = std::max(center.y - radius, 0);
+         y <= std::min(center.y + radius, image.rows - 1); y++) {
+        const uint8_t* row = image.ptr<uint8_t>(y);
+        for (int x = std::max(center.x - radius, 0);
+             x <= std::min(center.x + radius, image.cols - 1); x++) {
+            addColor(row[3 * x], row[3 * x + 1], row[3 * x + 2]);
+        }
+    }
+}
+
+bool ColorLut::contains(uint8_t blue, uint8_t green, uint8_t red) const {
+    uint32_t index = getIndex(blue, green, red);
+    return (m_table[index / 32] >> (index % 32)) & 1;
+}
+
+void ColorLut::apply(const cv::Mat& image, cv::Mat& mask,
+                     std::vector<int>& rowCounts) const {
+    mask.create(image.rows, image.cols, CV_8UC1);
+    rowCounts.resize(image.rows);
+
+    for (int y = 0; y < image.rows; y++) {
+        const uint8_t* in = image.ptr<uint8_t>(y);
+        uint8_t* out = mask.ptr<uint8_t>(y);
+
+        // The table bit is turned into 0 or 255 without branching
+        int count = 0;
+        for (int x = 0; x < image.cols; x++, in += 3) {
+            uint32_t index = getIndex(in[0], in[1], in[2]);
+            uint32_t bit = (m_table[index / 32] >> (index % 32)) & 1;
+            out[x] = -bit;
+            count += bit;
+        }
+        rowCounts[y] = count;
+    }
+}
+
+bool ColorLut::save(const std::string& fileName) const {
+    std::ofstream file(fileName, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    // Words are written little-endian regardless of the host
+    uint8_t buf[4];
+    auto write32 = [&](uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            buf[i] = value >> (8 * i);
+        }
+        file.write(reinterpret_cast<char*>(buf), sizeof(buf));
+    };
+
+    write32(k_magic);
+    for (uint32_t word : m_table) {
+        write32(word);
+    }
+
+    return file.good();
+}
+
+bool ColorLut::load(const std::string& fileName) {
+    std::ifstream file(fileName, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    uint8_t buf[4];
+    auto read32 = [&](uint32_t& value) {
+        if (!file.read(reinterpret_cast<char*>(buf), sizeof(buf))) {
+            return false;
+        }
+        value = buf[0] | (buf[1] << 8) | (buf[2] << 16) |
+                (static_cast<uint32_t>(buf[3]) << 24);
+        return true;
+    };
+
+    uint32_t magic;
+    if (!read32(magic) || magic != k_magic) {
+        return false;
+    }
+
+    decltype(m_table) table;
+    for (auto& word : table) {
+        if (!read32(word)) {
+            return false;
+        }
+    }
+
+    m_table = table;
+    return true;
+}
+
+uint32_t ColorLut::getIndex(uint8_t blue, uint8_t green, uint8_t red) {
+    return ((blue >> (8 - k_bits)) << (2 * k_bits)) |
+           ((green >> (8 - k_bits)) << k_bits) | (red >> (8 - k_bits));
+}
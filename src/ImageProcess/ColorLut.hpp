@@ -0,0 +1,66 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+/**
+ * Classifies BGR colors as target or not with a 32x32x32 lookup table
+ *
+ * Each channel is quantized to 5 bits, and the resulting 15-bit color indexes
+ * a table of 32768 bits (4 KB, which fits in L1 cache). A pixel is classified
+ * with one table lookup regardless of the shape of the color region the table
+ * describes. The table is built from sample colors, such as pixels the
+ * operator clicks on, and can be saved to and loaded from a file.
+ */
+class ColorLut {
+public:
+    // Marks every color as not-target
+    void clear();
+
+    // Returns true if no color is marked as target
+    bool empty() const;
+
+    /* Marks the cell containing the color as target, along with the cells
+     * within 'spread' cells of it on each channel so similar shades also pass
+     */
+    void addColor(uint8_t blue, uint8_t green, uint8_t red, int spread = 1);
+
+    /* Adds the color of every pixel within 'radius' pixels of 'center' in a
+     * BGR image. Pixels outside the image are ignored.
+     */
+    void addPatch(const cv::Mat& image, cv::Point center, int radius);
+
+    bool contains(uint8_t blue, uint8_t green, uint8_t red) const;
+
+    /* Sets 'mask' to 255 where the color of a BGR image is marked as target
+     * and 0 elsewhere. 'rowCounts' receives the number of pixels set in each
+     * row, like ColorFilter::apply().
+     */
+    void apply(const cv::Mat& image, cv::Mat& mask,
+               std::vector<int>& rowCounts) const;
+
+    // Returns false if the file couldn't be written
+    bool save(const std::string& fileName) const;
+
+    /* Returns false if the file couldn't be read or isn't a table, in which
+     * case the table is unchanged
+     */
+    bool load(const std::string& fileName);
+
+private:
+    static constexpr uint32_t k_magic = 0x494E534C;  // "INSL"
+    static constexpr int k_bits = 5;
+    static constexpr int k_cells = 1 << k_bits;
+
+    // One bit per cell, indexed by (blue << 10) | (green << 5) | red
+    std::array<uint32_t, k_cells * k_cells * k_cells / 32> m_table{};
+
+    static uint32_t getIndex(uint8_t blue, uint8_t green, uint8_t red);
+};
@@ -6,13 +6,20 @@
 
 #include <opencv2/imgproc/imgproc.hpp>
 
+bool FindTarget2013::needsColor() const { return false; }
+
 void FindTarget2013::prepareImage() {
-    cv::cvtColor(m_rawImage, m_grayChannel, CV_BGR2GRAY);
+    // Grayscale images are already luma
+    const cv::Mat* luma = &m_rawImage;
+    if (m_rawImage.channels() == 3) {
+        cv::cvtColor(m_rawImage, m_grayChannel, CV_BGR2GRAY);
+        luma = &m_grayChannel;
+    }
 
     /* Apply binary threshold to all channels
      * (Eliminates cross-hatching artifact in soft blacks)
      */
-    cv::threshold(m_grayChannel, m_grayChannel, 128, 255, CV_THRESH_BINARY);
+    cv::threshold(*luma, m_grayChannel, 128, 255, CV_THRESH_BINARY);
 
     // Perform dilation
     int dilationSize = 2;
@@ -49,6 +56,11 @@ void FindTarget2013::drawOverlay() {
     // R , G , B , A
     CvScalar lineColor = cvScalar(0x00, 0xFF, 0x00, 0xFF);
 
+    // Grayscale images only use the first value, so draw white on them
+    if (m_rawImage.channels() == 1) {
+        lineColor = cvScalar(0xFF);
+    }
+
     // Draw lines to show user where the targets are
     for (auto& target : m_targets) {
         cv::line(m_rawImage, target[0], target[1], lineColor, 2);
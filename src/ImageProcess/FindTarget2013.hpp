@@ -8,6 +8,10 @@
  * Processes a provided image and finds targets like the ones from FRC 2013
  */
 class FindTarget2013 : public ProcBase {
+public:
+    // Only the image's luma is used
+    bool needsColor() const;
+
 private:
     void prepareImage();
     void findTargets();
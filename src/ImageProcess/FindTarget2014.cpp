@@ -9,12 +9,19 @@ void FindTarget2014::clickEvent(int x, int y) {
     m_my = y;
 }
 
+bool FindTarget2014::needsColor() const { return false; }
+
 void FindTarget2014::prepareImage() {
-    cv::cvtColor(m_rawImage, m_grayChannel, CV_BGR2GRAY);
+    // Grayscale images are already luma
+    const cv::Mat* luma = &m_rawImage;
+    if (m_rawImage.channels() == 3) {
+        cv::cvtColor(m_rawImage, m_grayChannel, CV_BGR2GRAY);
+        luma = &m_grayChannel;
+    }
 
     // cv::adaptiveThreshold(m_grayChannel, m_grayChannel, 255,
     // CV_ADAPTIVE_THRESH_MEAN_C, CV_THRESH_BINARY, 3, 0);
-    cv::threshold(m_grayChannel, m_grayChannel, 128, 255, CV_THRESH_BINARY);
+    cv::threshold(*luma, m_grayChannel, 128, 255, CV_THRESH_BINARY);
 
     /* A pixel (1 channel) returned from at() here will be either 255 in all
      * channels or 0, which casts to either true or false respectively.
@@ -30,6 +37,11 @@ void FindTarget2014::drawOverlay() {
     // R , G , B , A
     cv::Scalar lineColor = cvScalar(0x00, 0xFF, 0x00, 0xFF);
 
+    // Grayscale images only use the first value, so draw white on them
+    if (m_rawImage.channels() == 1) {
+        lineColor = cv::Scalar(0xFF);
+    }
+
     // Determines scale of drawn box compared to full image
     float scale = m_overlayScale;
 
@@ -9,6 +9,9 @@
  */
 class FindTarget2014 : public ProcBase {
 public:
+    // Only the image's luma is used
+    bool needsColor() const;
+
     /* Returns true if point selected is bright enough to be considered part of
      * a target
      */
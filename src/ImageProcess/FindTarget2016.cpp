@@ -2,39 +2,288 @@
 
 #include "FindTarget2016.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <vector>
 
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include "ColorFilter.hpp"
+
+constexpr int FindTarget2016::k_benchmarkFrames;
+constexpr int FindTarget2016::k_clickRadius;
+constexpr int FindTarget2016::k_trackingReportFrames;
+constexpr int FindTarget2016::k_trackingMargin;
+constexpr double FindTarget2016::k_approxEpsilon;
+constexpr int FindTarget2016::k_morphologyReach;
+constexpr double FindTarget2016::k_candidateGreenScale;
+
+FindTarget2016::FindTarget2016() { m_stages["mask"] = &m_mask; }
+
 void FindTarget2016::prepareImage() {
-    // remove noise by eroding and dilating twice
-    cv::erode(m_rawImage, m_grayChannel, cv::Mat());
-    cv::erode(m_grayChannel, m_grayChannel, cv::Mat());
-    cv::dilate(m_grayChannel, m_grayChannel, cv::Mat());
-    cv::dilate(m_grayChannel, m_grayChannel, cv::Mat());
+    m_yCbCr = m_rawImage.channels() == 1 && m_cb != nullptr;
+    if (m_yCbCr) {
+        cv::Size chromaSize((m_rawImage.cols + 1) / 2,
+                            (m_rawImage.rows + 1) / 2);
+        cv::Mat cb(chromaSize, CV_8UC1, const_cast<uint8_t*>(m_cb));
+        cv::Mat cr(chromaSize, CV_8UC1, const_cast<uint8_t*>(m_cr));
+
+        uint8_t lower[3];
+        uint8_t upper[3];
+        getGreenRange(lower, upper);
+        m_yCbCrFilter.setRange(lower, upper);
+        m_yCbCrFilter.apply(m_rawImage, cb, cr, m_coarseMask, m_grayChannel,
+                            m_rowCounts);
+        openAndClose(m_grayChannel, m_mask);
+
+        // The planes are only valid for this image
+        m_cb = nullptr;
+        m_cr = nullptr;
+        m_streamed = false;
+        return;
+    }
+
+    if (m_colorLutEnabled) {
+        updateColorLut();
+    }
+
+    // Tracking and the pyramid make masks as regions are searched
+    if (!m_trackingEnabled && m_pyramidScale == 1) {
+        if (m_streamed && canStream() &&
+            m_grayChannel.size() == m_rawImage.size()) {
+            // The rows were classified as they were decoded
+            openAndClose(m_grayChannel, m_mask);
+        } else {
+            makeMask(m_pipeline, m_rawImage, m_grayChannel, m_mask);
+        }
+    }
+
+    m_streamed = false;
 }
 
 void FindTarget2016::findTargets() {
     m_targets.clear();
+    if (m_yCbCr) {
+        // The mask was made from YCbCr, which the searches can't do
+        findMaskTargets(m_mask, m_targets, m_center);
+        return;
+    }
+
+    if (m_trackingEnabled) {
+        trackTargets();
+    } else if (m_pyramidScale > 1) {
+        searchImage();
+    } else {
+        findMaskTargets(m_mask, m_targets, m_center);
+    }
+
+    if (m_benchmarkEnabled) {
+        runBenchmark();
+    }
+}
+
+bool FindTarget2016::wantsThumbnail() const {
+    return !m_colorLutEnabled || m_colorLut.empty();
+}
+
+void FindTarget2016::findCandidates(const uint8_t* thumbnail,
+                                    unsigned int width, unsigned int height,
+                                    unsigned int channels,
+                                    std::vector<bool>& candidateRows) {
+    /* Rows which aren't picked are filled with their blocks' average colors,
+     * which fail the loosened range and so the green filter too. The range is
+     * the same for red and blue, so the thumbnail's RGB order doesn't matter.
+     */
+    uint8_t lower[3];
+    uint8_t upper[3];
+    getGreenRange(lower, upper);
+    lower[1] *= k_candidateGreenScale;
+
+    m_thumbnailMask.resize(width);
+    for (unsigned int y = 0; y < height; y++) {
+        if (ColorFilter::applyRow(thumbnail + y * width * channels,
+                                  m_thumbnailMask.data(), width, lower,
+                                  upper) == 0) {
+            continue;
+        }
+
+        // Neighboring rows hold the parts of targets which cover less
+        for (unsigned int i = std::max(y, 1u) - 1;
+             i < std::min(y + 2, height); i++) {
+            candidateRows[i] = true;
+        }
+    }
+}
+
+void FindTarget2016::beginImage(unsigned int width, unsigned int height,
+                                unsigned int channels) {
+    m_streamed = false;
+    m_streaming = channels == 3 && canStream();
+    if (m_streaming) {
+        m_grayChannel.create(height, width, CV_8UC1);
+        m_rowCounts.resize(height);
+    }
+}
+
+void FindTarget2016::processRows(const uint8_t* rows, unsigned int firstRow,
+                                 unsigned int numRows, unsigned int stride) {
+    if (!m_streaming) {
+        return;
+    }
+
+    /* The decoder produces RGB rather than BGR, but the green range is the
+     * same for red and blue, so it applies without swapping them
+     */
+    uint8_t lower[3];
+    uint8_t upper[3];
+    getGreenRange(lower, upper);
+
+    for (unsigned int i = 0; i < numRows; i++) {
+        unsigned int y = firstRow + i;
+        m_rowCounts[y] = ColorFilter::applyRow(
+            rows + i * stride, m_grayChannel.ptr<uint8_t>(y),
+            m_grayChannel.cols, lower, upper);
+    }
+}
+
+void FindTarget2016::endImage() {
+    m_streamed = m_streaming;
+    m_streaming = false;
+}
+
+bool FindTarget2016::canStream() const {
+    return m_streamingEnabled && m_pipeline == Pipeline::thresholdFirst &&
+           !m_trackingEnabled && m_pyramidScale == 1 &&
+           !(m_colorLutEnabled && !m_colorLut.empty());
+}
+
+void FindTarget2016::getGreenRange(uint8_t lower[3], uint8_t upper[3]) const {
+    lower[0] = 0;
+    lower[1] = m_lowerGreenFilterValue;
+    lower[2] = 0;
+    upper[0] = 200;
+    upper[1] = 255;
+    upper[2] = 200;
+}
+
+void FindTarget2016::updateColorLut() {
+    std::vector<cv::Point> clicks;
+    bool clear;
+    {
+        std::lock_guard<std::mutex> lock(m_clickMutex);
+        clicks.swap(m_clicks);
+        clear = m_clearColorLut;
+        m_clearColorLut = false;
+    }
 
-    // Filter green contours
-    cv::Mat rgb;
-    cv::inRange(m_grayChannel, cv::Scalar(0, m_lowerGreenFilterValue, 0),
-                cv::Scalar(200, 255, 200), rgb);
+    if (!clear && clicks.empty()) {
+        return;
+    }
+
+    if (clear) {
+        m_colorLut.clear();
+    }
+
+    // The clicks are sampled before drawOverlay() draws over the image
+    for (auto& click : clicks) {
+        m_colorLut.addPatch(m_rawImage, click, k_clickRadius);
+    }
+
+    if (!m_colorLut.save(m_colorLutFile)) {
+        std::cout << "FindTarget2016: failed to save color table to '"
+                  << m_colorLutFile << "'\n";
+    }
+}
+
+void FindTarget2016::classify(const cv::Mat& image, cv::Mat& mask) {
+    if (m_colorLutEnabled && !m_colorLut.empty()) {
+        m_colorLut.apply(image, mask, m_rowCounts);
+        return;
+    }
+
+    uint8_t lower[3];
+    uint8_t upper[3];
+    getGreenRange(lower, upper);
+    ColorFilter::apply(image, lower, upper, mask, m_rowCounts);
+}
+
+void FindTarget2016::makeMask(Pipeline pipeline, const cv::Mat& image,
+                              cv::Mat& prepared, cv::Mat& mask) {
+    if (pipeline == Pipeline::morphologyFirst) {
+        // remove noise by eroding and dilating twice
+        cv::erode(image, prepared, cv::Mat());
+        cv::erode(prepared, prepared, cv::Mat());
+        cv::dilate(prepared, prepared, cv::Mat());
+        cv::dilate(prepared, prepared, cv::Mat());
+
+        // Filter green contours
+        classify(prepared, mask);
+        return;
+    }
+
+    /* Thresholding first leaves one channel for the morphology instead of
+     * three. Opening twice removes the same specks as eroding and dilating
+     * the color image twice, and closing fills pinholes in the targets.
+     */
+    classify(image, prepared);
+    openAndClose(prepared, mask);
+}
+
+void FindTarget2016::openAndClose(const cv::Mat& prepared, cv::Mat& mask) {
+    mask.create(prepared.rows, prepared.cols, CV_8UC1);
+    mask.setTo(cv::Scalar(0));
+
+    /* Only rows near green pixels can be set after the morphology, since the
+     * open and close grow regions by at most k_morphologyReach rows
+     */
+    auto first = std::find_if(m_rowCounts.begin(), m_rowCounts.end(),
+                              [](int count) { return count > 0; });
+    if (first == m_rowCounts.end()) {
+        return;
+    }
+    auto last = std::find_if(m_rowCounts.rbegin(), m_rowCounts.rend(),
+                             [](int count) { return count > 0; });
+
+    cv::Range rows(
+        std::max<int>(first - m_rowCounts.begin() - k_morphologyReach, 0),
+        std::min<int>(m_rowCounts.rend() - last + k_morphologyReach,
+                      prepared.rows));
+
+    /* The band is packed to one bit per pixel for the open and close, which
+     * give the same result as cv::morphologyEx() on the bytes
+     */
+    m_bitMask.fromMat(prepared.rowRange(rows.start, rows.end));
+    m_bitMask.open(2);
+    m_bitMask.close();
+    cv::Mat band = mask.rowRange(rows.start, rows.end);
+    m_bitMask.toMat(band);
+}
+
+int FindTarget2016::findMaskTargets(cv::Mat& mask,
+                                    std::vector<Target>& targets,
+                                    cv::Point& center) {
+    if (m_blobDetector != nullptr) {
+        return findComponentTargets(mask, targets, center);
+    }
 
     std::vector<std::vector<cv::Point>> contours;
     std::vector<cv::Vec4i> hierarchy;
 
     // Find the countours
-    cv::findContours(rgb, contours, hierarchy, cv::RETR_TREE,
+    cv::findContours(mask, contours, hierarchy, cv::RETR_TREE,
                      cv::CHAIN_APPROX_SIMPLE);
 
     std::vector<std::vector<cv::Point>> filtered;
 
-    // Filter contours with a small perimeter
+    /* Filter contours with a small perimeter. The limits are relative to the
+     * whole image since the mask may only cover part of it.
+     */
+    double minPerimeter = m_minPerimeter * m_rawImage.cols;
+    double maxPerimeter = m_maxPerimeter * m_rawImage.cols;
     for (auto& contour : contours) {
         auto perimeter = arcLength(contour, true);
-        if (perimeter > 100 && perimeter < 350) {
+        if (perimeter > minPerimeter && perimeter < maxPerimeter) {
             filtered.emplace_back(contour);
         }
     }
@@ -51,29 +300,320 @@ void FindTarget2016::findTargets() {
     }
 
     if (maxArea == 0) {
-        m_targets = filtered;
-        return;
+        targets = filtered;
+        return 0;
     }
 
     // simplify large contours
-    cv::approxPolyDP(cv::Mat(largeContour), largeContour, 5, true);
+    cv::approxPolyDP(cv::Mat(largeContour), largeContour,
+                     k_approxEpsilon * m_rawImage.cols, true);
 
     // convex hull
     std::vector<cv::Point> convexHull;
     cv::convexHull(largeContour, convexHull, false);
 
     // Save contours at this point so we have a target
-    m_targets.emplace_back(largeContour);
+    targets.emplace_back(largeContour);
 
     // find center of mass
     cv::Moments mo = cv::moments(convexHull);
-    m_center = cv::Point(mo.m10 / mo.m00, mo.m01 / mo.m00);
+    center = cv::Point(mo.m10 / mo.m00, mo.m01 / mo.m00);
+    return maxArea;
+}
+
+int FindTarget2016::findComponentTargets(const cv::Mat& mask,
+                                         std::vector<Target>& targets,
+                                         cv::Point& center) {
+    double minPerimeter = m_minPerimeter * m_rawImage.cols;
+    double maxPerimeter = m_maxPerimeter * m_rawImage.cols;
+
+    const Blob* largest = nullptr;
+    for (auto& blob : m_blobDetector->detect(mask)) {
+        if (blob.perimeter > minPerimeter && blob.perimeter < maxPerimeter &&
+            (largest == nullptr || blob.area > largest->area)) {
+            largest = &blob;
+        }
+    }
+
+    if (largest == nullptr) {
+        return 0;
+    }
+
+    /* The bounding box stands in for the simplified contour. The center is
+     * the region's centroid, which the labeling pass already measured.
+     */
+    const cv::Rect& box = largest->box;
+    int right = box.x + box.width - 1;
+    int bottom = box.y + box.height - 1;
+    targets.emplace_back(Target{cv::Point(box.x, box.y),
+                                cv::Point(right, box.y),
+                                cv::Point(right, bottom),
+                                cv::Point(box.x, bottom)});
+    center = cv::Point(std::lround(largest->centroid.x),
+                       std::lround(largest->centroid.y));
+
+    return largest->area;
+}
+
+void FindTarget2016::trackTargets() {
+    auto startTime = std::chrono::steady_clock::now();
+    bool searchWhole = true;
+
+    cv::Rect region = getTrackingRegion();
+    if (!region.empty()) {
+        clearMask();
+        cv::Point center;
+        bool found = searchRegion(region, m_targets, center) > 0;
+        m_regionSearches++;
+        auto endTime = std::chrono::steady_clock::now();
+        m_regionSearchTime += endTime - startTime;
+
+        if (found) {
+            m_center = center;
+            m_trackedBox = cv::boundingRect(m_targets.back());
+            m_regionHits++;
+            m_framesSinceFullSearch++;
+            searchWhole = false;
+        } else if (m_regionOnly) {
+            /* The rest of the image is stale, so searching it could find where
+             * the target was. It's searched once the next image is decoded
+             * whole.
+             */
+            m_targets.clear();
+            m_trackedBox = cv::Rect();
+            searchWhole = false;
+        } else {
+            // The target was lost, so fall back to the whole image
+            startTime = endTime;
+            m_targets.clear();
+        }
+    }
+
+    if (searchWhole) {
+        searchImage();
+        m_fullSearches++;
+        m_fullSearchTime += std::chrono::steady_clock::now() - startTime;
+        m_framesSinceFullSearch = 0;
+    }
+
+    if (m_regionSearches + m_fullSearches >= k_trackingReportFrames) {
+        using ms = std::chrono::duration<double, std::milli>;
+
+        std::cout << "FindTarget2016: target in tracked region for "
+                  << m_regionHits << "/" << m_regionSearches
+                  << " searches, region search "
+                  << ms(m_regionSearchTime).count() /
+                         std::max(m_regionSearches, 1)
+                  << " ms, full search "
+                  << ms(m_fullSearchTime).count() / std::max(m_fullSearches, 1)
+                  << " ms (" << m_fullSearches << " searches)\n";
+
+        m_regionSearches = 0;
+        m_regionHits = 0;
+        m_fullSearches = 0;
+        m_regionSearchTime = std::chrono::steady_clock::duration{0};
+        m_fullSearchTime = std::chrono::steady_clock::duration{0};
+    }
+}
+
+cv::Rect FindTarget2016::getTrackingRegion() const {
+    if (m_trackedBox.empty() || m_framesSinceFullSearch >= m_verifyInterval) {
+        return cv::Rect();
+    }
+
+    // Pad the box by its own size so a moving target stays inside it
+    cv::Rect region(m_trackedBox.x - m_trackedBox.width - k_trackingMargin,
+                    m_trackedBox.y - m_trackedBox.height - k_trackingMargin,
+                    3 * m_trackedBox.width + 2 * k_trackingMargin,
+                    3 * m_trackedBox.height + 2 * k_trackingMargin);
+    return region & cv::Rect(0, 0, m_rawImage.cols, m_rawImage.rows);
+}
+
+cv::Rect FindTarget2016::getNextRegion() const {
+    if (!m_trackingEnabled || m_yCbCr) {
+        return cv::Rect();
+    }
+
+    /* The morphology-first pipeline's erosions read pixels just outside the
+     * region, so those are included
+     */
+    cv::Rect region = getTrackingRegion();
+    if (region.empty()) {
+        return region;
+    }
+    region = cv::Rect(region.x - k_morphologyReach,
+                      region.y - k_morphologyReach,
+                      region.width + 2 * k_morphologyReach,
+                      region.height + 2 * k_morphologyReach);
+    return region & cv::Rect(0, 0, m_rawImage.cols, m_rawImage.rows);
+}
+
+void FindTarget2016::setRegionOnly(bool regionOnly) {
+    m_regionOnly = regionOnly;
+}
+
+bool FindTarget2016::searchImage() {
+    cv::Point center;
+    int area;
+    if (m_pyramidScale > 1) {
+        area = searchPyramid(m_targets, center);
+    } else {
+        m_mask.create(m_rawImage.rows, m_rawImage.cols, CV_8UC1);
+        area = searchRegion(cv::Rect(0, 0, m_rawImage.cols, m_rawImage.rows),
+                            m_targets, center);
+    }
+
+    if (area > 0) {
+        m_center = center;
+        m_trackedBox = cv::boundingRect(m_targets.back());
+    } else {
+        m_trackedBox = cv::Rect();
+    }
+
+    return area > 0;
+}
+
+int FindTarget2016::searchPyramid(std::vector<Target>& targets,
+                                  cv::Point& center) {
+    /* Sampling one pixel per block is much cheaper than averaging the blocks,
+     * and specks it picks up are too small to pass the perimeter limits
+     */
+    cv::resize(m_rawImage, m_coarseImage,
+               cv::Size(m_rawImage.cols / m_pyramidScale,
+                        m_rawImage.rows / m_pyramidScale),
+               0, 0, cv::INTER_NEAREST);
+    classify(m_coarseImage, m_coarseMask);
+
+    std::vector<std::vector<cv::Point>> contours;
+    cv::findContours(m_coarseMask, contours, cv::RETR_EXTERNAL,
+                     cv::CHAIN_APPROX_SIMPLE);
+
+    /* Coarse perimeters are only estimates, so candidates are kept within a
+     * looser range and the real limits are applied at full resolution
+     */
+    double minPerimeter = m_minPerimeter * m_coarseMask.cols / 2;
+    double maxPerimeter = m_maxPerimeter * m_coarseMask.cols * 2;
+
+    clearMask();
+    cv::Rect image(0, 0, m_rawImage.cols, m_rawImage.rows);
+    int margin = 2 * m_pyramidScale + k_morphologyReach;
+
+    int maxArea = 0;
+    for (auto& contour : contours) {
+        double perimeter = cv::arcLength(contour, true);
+        if (perimeter < minPerimeter || perimeter > maxPerimeter) {
+            continue;
+        }
+
+        cv::Rect box = cv::boundingRect(contour);
+        cv::Rect window(box.x * m_pyramidScale - margin,
+                        box.y * m_pyramidScale - margin,
+                        box.width * m_pyramidScale + 2 * margin,
+                        box.height * m_pyramidScale + 2 * margin);
+        window &= image;
+
+        m_windowTargets.clear();
+        cv::Point windowCenter;
+        int area = searchRegion(window, m_windowTargets, windowCenter);
+        if (area > maxArea) {
+            maxArea = area;
+            targets.swap(m_windowTargets);
+            center = windowCenter;
+        }
+    }
+
+    return maxArea;
+}
+
+int FindTarget2016::searchRegion(const cv::Rect& region,
+                                 std::vector<Target>& targets,
+                                 cv::Point& center) {
+    cv::Mat mask = m_mask(region);
+    makeMask(m_pipeline, m_rawImage(region), m_grayChannel, mask);
+
+    int area = findMaskTargets(mask, targets, center);
+
+    for (auto& target : targets) {
+        for (auto& point : target) {
+            point += region.tl();
+        }
+    }
+    if (area > 0) {
+        center += region.tl();
+    }
+
+    return area;
+}
+
+void FindTarget2016::clearMask() {
+    // Pixels outside the searched regions are left out of the mask
+    m_mask.create(m_rawImage.rows, m_rawImage.cols, CV_8UC1);
+    m_mask.setTo(cv::Scalar(0));
+}
+
+void FindTarget2016::updateCoarseStage() {
+    if (m_pyramidScale > 1 || m_yCbCrEnabled) {
+        m_stages["coarse"] = &m_coarseMask;
+    } else {
+        m_stages.erase("coarse");
+    }
+}
+
+void FindTarget2016::runBenchmark() {
+    std::vector<Target> targets[2];
+    cv::Point centers[2] = {{-1, -1}, {-1, -1}};
+    std::chrono::steady_clock::duration* times[2] = {&m_morphologyFirstTime,
+                                                     &m_thresholdFirstTime};
+    Pipeline pipelines[2] = {Pipeline::morphologyFirst,
+                             Pipeline::thresholdFirst};
+
+    for (int i = 0; i < 2; i++) {
+        auto startTime = std::chrono::steady_clock::now();
+        makeMask(pipelines[i], m_rawImage, m_benchmarkPrepared,
+                 m_benchmarkMask);
+        findMaskTargets(m_benchmarkMask, targets[i], centers[i]);
+        *times[i] += std::chrono::steady_clock::now() - startTime;
+    }
+
+    // The pipelines agree if they found as many targets at the same place
+    if (targets[0].size() == targets[1].size() &&
+        std::abs(centers[0].x - centers[1].x) <= 2 &&
+        std::abs(centers[0].y - centers[1].y) <= 2) {
+        m_benchmarkMatches++;
+    }
+    m_benchmarkCount++;
+
+    if (m_benchmarkCount == k_benchmarkFrames) {
+        using ms = std::chrono::duration<double, std::milli>;
+        double morphologyFirst = ms(m_morphologyFirstTime).count();
+        double thresholdFirst = ms(m_thresholdFirstTime).count();
+
+        std::cout << "FindTarget2016: morphology first "
+                  << morphologyFirst / m_benchmarkCount
+                  << " ms, threshold first "
+                  << thresholdFirst / m_benchmarkCount << " ms ("
+                  << morphologyFirst / thresholdFirst
+                  << "x), same targets in " << m_benchmarkMatches << "/"
+                  << m_benchmarkCount << " frames (color filter uses "
+                  << ColorFilter::getInstructionSet() << ", morphology uses "
+                  << BitMask::getInstructionSet() << ")\n";
+
+        m_morphologyFirstTime = std::chrono::steady_clock::duration{0};
+        m_thresholdFirstTime = std::chrono::steady_clock::duration{0};
+        m_benchmarkCount = 0;
+        m_benchmarkMatches = 0;
+    }
 }
 
 void FindTarget2016::drawOverlay() {
     // R , G , B , A
     CvScalar lineColor = cvScalar(0x00, 0x00, 0xFF, 0xFF);
 
+    // Grayscale images only use the first value, so draw white on them
+    if (m_rawImage.channels() == 1) {
+        lineColor = cvScalar(0xFF, 0xFF, 0xFF, 0xFF);
+    }
+
     for (auto& target : m_targets) {
         // Draw lines to show user where the targets are
         cv::line(m_rawImage, target[0], target[1], lineColor, 3);
@@ -108,3 +648,74 @@ void FindTarget2016::setLowerGreenFilterValue(const float range) {
 void FindTarget2016::setOverlayPercent(const float overlayPercent) {
     m_overlayScale = overlayPercent / 100.f;
 }
+
+void FindTarget2016::setPipeline(Pipeline pipeline) { m_pipeline = pipeline; }
+
+void FindTarget2016::setDetector(Detector detector) {
+    if (detector == Detector::components) {
+        if (m_blobDetector == nullptr) {
+            m_blobDetector = std::make_unique<BlobDetector>();
+        }
+    } else {
+        m_blobDetector = nullptr;
+    }
+}
+
+void FindTarget2016::enableStreaming(bool enable) {
+    m_streamingEnabled = enable;
+}
+
+void FindTarget2016::setChromaPlanes(const uint8_t* cb, const uint8_t* cr) {
+    m_cb = cb;
+    m_cr = cr;
+}
+
+void FindTarget2016::enableBenchmark(bool enable) {
+    m_benchmarkEnabled = enable;
+}
+
+void FindTarget2016::enableTracking(bool enable, int verifyInterval) {
+    m_trackingEnabled = enable;
+    m_verifyInterval = std::max(verifyInterval, 1);
+    m_trackedBox = cv::Rect();
+}
+
+void FindTarget2016::setPerimeterRange(float minPercent, float maxPercent) {
+    m_minPerimeter = minPercent / 100.f;
+    m_maxPerimeter = maxPercent / 100.f;
+}
+
+void FindTarget2016::setPyramidScale(int scale) {
+    m_pyramidScale = std::max(scale, 1);
+    updateCoarseStage();
+}
+
+void FindTarget2016::enableYCbCr(bool enable) {
+    m_yCbCrEnabled = enable;
+    updateCoarseStage();
+}
+
+void FindTarget2016::setColorLut(const std::string& fileName) {
+    m_colorLutEnabled = true;
+    m_colorLutFile = fileName;
+
+    if (!m_colorLut.load(fileName)) {
+        std::cout << "FindTarget2016: no color table loaded from '" << fileName
+                  << "'; click on targets to train one\n";
+    }
+}
+
+void FindTarget2016::clearColorLut() {
+    std::lock_guard<std::mutex> lock(m_clickMutex);
+    m_clicks.clear();
+    m_clearColorLut = true;
+}
+
+void FindTarget2016::clickEvent(int x, int y) {
+    if (!m_colorLutEnabled) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_clickMutex);
+    m_clicks.emplace_back(x, y);
+}
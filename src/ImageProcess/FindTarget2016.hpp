@@ -2,15 +2,52 @@
 
 #pragma once
 
+#include <chrono>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
+#include "../MJPEG/CandidateFinder.hpp"
+#include "../MJPEG/ScanlineSink.hpp"
+#include "BitMask.hpp"
+#include "BlobDetector.hpp"
+#include "ColorLut.hpp"
 #include "ProcBase.hpp"
+#include "YCbCrFilter.hpp"
 
 /**
  * Processes a provided image and finds targets like the ones from FRC 2016
+ *
+ * As a ScanlineSink, it can classify the rows of each frame while the client
+ * decodes them. See enableStreaming(). As a CandidateFinder, it picks the rows
+ * of each frame the client decodes from a thumbnail of it.
  */
-class FindTarget2016 : public ProcBase {
+class FindTarget2016 : public ProcBase,
+                       public ScanlineSink,
+                       public CandidateFinder {
 public:
+    // Order in which the green filter and noise removal are applied
+    enum class Pipeline {
+        // Erode and dilate the BGR image, then threshold it into a mask
+        morphologyFirst,
+
+        // Threshold the BGR image into a mask, then open and close the mask
+        thresholdFirst
+    };
+
+    // How regions of the mask are found
+    enum class Detector {
+        // Trace region outlines with cv::findContours()
+        contours,
+
+        // Label connected regions and use their statistics
+        components
+    };
+
+    FindTarget2016();
+
     /* Sets scale of box dimensions compared to image dimensions
      * 'percent' should be a percentage from 0 to 100 inclusive
      */
@@ -19,11 +56,293 @@ public:
     // Sets the range for green colors that will pass filtering
     void setLowerGreenFilterValue(const float range);
 
+    void setPipeline(Pipeline pipeline);
+
+    void setDetector(Detector detector);
+
+    /* When enabled, every pipeline is also run on each frame. Their average
+     * processing times and how often they found the same targets are printed
+     * every k_benchmarkFrames frames.
+     */
+    void enableBenchmark(bool enable);
+
+    /* Classifies pixels with a color table trained by clicking on targets
+     * instead of with the green filter range. The table is loaded from the
+     * file if it exists and saved to it after every click. Until the table has
+     * been trained, the green filter range is used.
+     */
+    void setColorLut(const std::string& fileName);
+
+    // Forgets every color the color table was trained with
+    void clearColorLut();
+
+    // Adds the colors around the clicked pixel to the color table
+    void clickEvent(int x, int y);
+
+    /* When enabled, only a region around the last target found is searched.
+     * The whole image is searched when the target is lost and every
+     * 'verifyInterval' frames. How often the region contained the target and
+     * the average cost of each kind of search are printed every
+     * k_trackingReportFrames frames.
+     */
+    void enableTracking(bool enable, int verifyInterval);
+
+    /* Sets the range of target perimeters as percentages of the image width,
+     * so the same range works at any resolution
+     */
+    void setPerimeterRange(float minPercent, float maxPercent);
+
+    /* While the tracked region is being searched, returns it so only it needs
+     * to be decoded. If the target is lost from a region-only image, no target
+     * is reported for it and the next image is decoded whole.
+     */
+    cv::Rect getNextRegion() const;
+
+    void setRegionOnly(bool regionOnly);
+
+    /* When 'scale' is greater than 1, candidates are found in an image
+     * downscaled by that factor on each side, and targets are only searched
+     * for at full resolution in windows around them
+     */
+    void setPyramidScale(int scale);
+
+    /* Tells the processor whether images will come with chroma planes from
+     * setChromaPlanes(). The "coarse" stage is only offered while the pyramid
+     * or the chroma planes produce it.
+     */
+    void enableYCbCr(bool enable);
+
+    /* When enabled, green pixels are found in each batch of rows while the
+     * client decodes them, so the pipeline doesn't read the whole image again
+     * to classify it. This only applies to the threshold-first pipeline
+     * searching the whole image without a trained color table; other frames
+     * are classified after decoding as usual.
+     */
+    void enableStreaming(bool enable);
+
+    /* Gives the Cb and Cr planes of the next image, which must be the luma of
+     * an image decoded with ClientBase::setChromaPlanes(). Green pixels are
+     * then classified from YCbCr without converting the image to BGR, and
+     * the "coarse" stage shows which chroma samples admit green. The planes
+     * must stay valid until processImage() returns. Tracking, the pyramid,
+     * the morphology-first pipeline, and the color table aren't used for
+     * these images.
+     */
+    void setChromaPlanes(const uint8_t* cb, const uint8_t* cr);
+
+    /* Picks rows of blocks whose average color could come from green pixels
+     * covering part of the block, along with the rows next to them. No
+     * thumbnail is wanted while a trained color table is in use, since its
+     * colors can't be bounded from a block's average.
+     */
+    bool wantsThumbnail() const;
+    void findCandidates(const uint8_t* thumbnail, unsigned int width,
+                        unsigned int height, unsigned int channels,
+                        std::vector<bool>& candidateRows);
+
+    void beginImage(unsigned int width, unsigned int height,
+                    unsigned int channels);
+    void processRows(const uint8_t* rows, unsigned int firstRow,
+                     unsigned int numRows, unsigned int stride);
+    void endImage();
+
 private:
+    static constexpr int k_benchmarkFrames = 100;
+
+    // Pixels around a click whose colors are added to the color table
+    static constexpr int k_clickRadius = 2;
+
+    static constexpr int k_trackingReportFrames = 100;
+
+    /* Pixels added to each side of the search region on top of the size of
+     * the last target's bounding box
+     */
+    static constexpr int k_trackingMargin = 8;
+
+    // Tolerance of the target's simplified polygon as a fraction of the width
+    static constexpr double k_approxEpsilon = 5.0 / 320.0;
+
+    /* Rows the threshold-first open and close can spread a region by. Rows
+     * further than this from any green pixel are left empty.
+     */
+    static constexpr int k_morphologyReach = 3;
+
+    /* Fraction of the green filter's lower bound a block's average green must
+     * reach for the block to be a candidate. Targets narrower than a block
+     * only raise its average part of the way.
+     */
+    static constexpr double k_candidateGreenScale = 0.5;
+
     void prepareImage();
     void findTargets();
     void drawOverlay();
 
+    // Returns true if decoded rows can be classified as they arrive
+    bool canStream() const;
+
+    // Fills in the range of the green filter in BGR order
+    void getGreenRange(uint8_t lower[3], uint8_t upper[3]) const;
+
+    // Applies clicks and clears requested since the last frame
+    void updateColorLut();
+
+    /* Sets 'mask' to 255 where 'image' has a target color. Uses the color
+     * table if it's enabled and trained, and the green filter range otherwise.
+     */
+    void classify(const cv::Mat& image, cv::Mat& mask);
+
+    /* Filters green pixels of 'image' into 'mask' using the given pipeline.
+     * 'prepared' receives the pipeline's intermediate image.
+     */
+    void makeMask(Pipeline pipeline, const cv::Mat& image, cv::Mat& prepared,
+                  cv::Mat& mask);
+
+    /* Opens and closes 'prepared', the output of classify(), into 'mask'.
+     * m_rowCounts must hold the number of pixels set in each row of
+     * 'prepared'.
+     */
+    void openAndClose(const cv::Mat& prepared, cv::Mat& mask);
+
+    /* Finds targets in a mask. Returns the area of the target found, or 0 if
+     * none was found. 'center' is only updated if a target was found.
+     */
+    int findMaskTargets(cv::Mat& mask, std::vector<Target>& targets,
+                        cv::Point& center);
+
+    /* findMaskTargets() for the components detector. The target is the
+     * largest region's bounding box, and its center is the region's centroid.
+     */
+    int findComponentTargets(const cv::Mat& mask, std::vector<Target>& targets,
+                             cv::Point& center);
+
+    // Searches the tracked region or the whole image for targets
+    void trackTargets();
+
+    /* Returns the region around the last target to search next, or an empty
+     * rectangle if the whole image should be searched
+     */
+    cv::Rect getTrackingRegion() const;
+
+    /* Searches the whole image, either directly or through the pyramid, and
+     * updates the tracked box. Returns true if a target was found.
+     */
+    bool searchImage();
+
+    /* Finds candidates in the downscaled image and searches a full resolution
+     * window around each. Returns the area of the largest target found, or 0.
+     */
+    int searchPyramid(std::vector<Target>& targets, cv::Point& center);
+
+    /* Searches the given region of the raw image. m_mask must already be
+     * allocated. 'targets' and 'center' are in image coordinates. Returns the
+     * area of the target found, or 0 if none was found.
+     */
+    int searchRegion(const cv::Rect& region, std::vector<Target>& targets,
+                     cv::Point& center);
+
+    // Allocates m_mask for the raw image and clears it
+    void clearMask();
+
+    // Offers the "coarse" stage only if the pyramid or chroma planes fill it
+    void updateCoarseStage();
+
+    // Runs each pipeline on the raw image and accumulates the results
+    void runBenchmark();
+
+    // Green pixels which passed filtering (output of classify())
+    cv::Mat m_mask;
+
+    // Number of green pixels in each row of the unfiltered mask
+    std::vector<int> m_rowCounts;
+
+    // Bit-packed band of the mask for the threshold-first morphology
+    BitMask m_bitMask;
+
+    Pipeline m_pipeline = Pipeline::morphologyFirst;
+
+    // Only created when the components detector is used
+    std::unique_ptr<BlobDetector> m_blobDetector;
+
     int m_lowerGreenFilterValue = 230;
     float m_overlayScale = 1.f;
+
+    // Target perimeter limits as fractions of the image width
+    float m_minPerimeter = 100.f / 320.f;
+    float m_maxPerimeter = 350.f / 320.f;
+
+    /* ===== Pyramid state ===== */
+    int m_pyramidScale = 1;
+
+    // True if images are expected to come with chroma planes
+    bool m_yCbCrEnabled = false;
+    cv::Mat m_coarseImage;
+    cv::Mat m_coarseMask;
+    std::vector<Target> m_windowTargets;
+    /* ========================= */
+
+    /* ===== Benchmark state ===== */
+    bool m_benchmarkEnabled = false;
+    cv::Mat m_benchmarkPrepared;
+    cv::Mat m_benchmarkMask;
+    std::chrono::steady_clock::duration m_morphologyFirstTime{0};
+    std::chrono::steady_clock::duration m_thresholdFirstTime{0};
+    int m_benchmarkCount = 0;
+    int m_benchmarkMatches = 0;
+    /* =========================== */
+
+    /* ===== Tracking state ===== */
+    bool m_trackingEnabled = false;
+    int m_verifyInterval = 1;
+
+    // Bounding box of the last target found, or empty if it was lost
+    cv::Rect m_trackedBox;
+
+    int m_framesSinceFullSearch = 0;
+
+    // True if only the tracked region of the image is decoded
+    bool m_regionOnly = false;
+
+    int m_regionSearches = 0;
+    int m_regionHits = 0;
+    int m_fullSearches = 0;
+    std::chrono::steady_clock::duration m_regionSearchTime{0};
+    std::chrono::steady_clock::duration m_fullSearchTime{0};
+    /* ========================== */
+
+    /* ===== Streaming state ===== */
+    bool m_streamingEnabled = false;
+
+    // True while the rows of the image being decoded are being classified
+    bool m_streaming = false;
+
+    /* True if the last image decoded was classified into m_grayChannel and
+     * m_rowCounts, and it hasn't been processed yet
+     */
+    bool m_streamed = false;
+    /* =========================== */
+
+    // Classification of one row of the thumbnail given to findCandidates()
+    std::vector<uint8_t> m_thumbnailMask;
+
+    /* ===== YCbCr state ===== */
+    YCbCrFilter m_yCbCrFilter;
+
+    // Chroma planes of the next image, or nullptr if it isn't YCbCr
+    const uint8_t* m_cb = nullptr;
+    const uint8_t* m_cr = nullptr;
+
+    // True if the image being processed was classified from YCbCr
+    bool m_yCbCr = false;
+    /* ======================= */
+
+    /* ===== Color table state ===== */
+    bool m_colorLutEnabled = false;
+    ColorLut m_colorLut;
+    std::string m_colorLutFile;
+
+    // Requests from the GUI thread waiting for the next frame
+    std::mutex m_clickMutex;
+    std::vector<cv::Point> m_clicks;
+    bool m_clearColorLut = false;
+    /* ============================= */
 };
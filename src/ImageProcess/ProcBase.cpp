@@ -4,12 +4,13 @@
 
 #include <opencv2/highgui/highgui.hpp>
 
-void ProcBase::setImage(uint8_t* image, uint32_t width, uint32_t height) {
+void ProcBase::setImage(uint8_t* image, uint32_t width, uint32_t height,
+                        uint32_t channels) {
     // Create new image and store data from provided image into it
-    m_rawImage = cv::Mat(height, width, CV_8UC(3), image);
+    m_rawImage = cv::Mat(height, width, CV_8UC(channels), image);
 
     // Used later after image is processed
-    m_grayChannel.create(width, height, CV_8UC(1));
+    m_grayChannel.create(height, width, CV_8UC(1));
 }
 
 void ProcBase::processImage() {
@@ -40,10 +41,51 @@ uint32_t ProcBase::getProcessedNumChannels() const {
     return m_rawImage.channels();
 }
 
+bool ProcBase::needsColor() const { return true; }
+
+cv::Rect ProcBase::getNextRegion() const { return cv::Rect(); }
+
+void ProcBase::setRegionOnly(bool regionOnly) { (void)regionOnly; }
+
 const std::vector<Target>& ProcBase::getTargetPositions() const {
     return m_targets;
 }
 
+void ProcBase::getTargetRecord(std::vector<uint8_t>& record) const {
+    auto append16 = [&](uint16_t value) {
+        record.emplace_back(value & 0xFF);
+        record.emplace_back(value >> 8);
+    };
+
+    record.clear();
+    append16(m_targets.size());
+    for (auto& target : m_targets) {
+        append16(target.size());
+        for (auto& point : target) {
+            append16(static_cast<int16_t>(point.x));
+            append16(static_cast<int16_t>(point.y));
+        }
+    }
+}
+
+const cv::Mat* ProcBase::getStage(const std::string& name) const {
+    auto stage = m_stages.find(name);
+    if (stage == m_stages.end()) {
+        return nullptr;
+    }
+
+    return stage->second;
+}
+
+std::vector<std::string> ProcBase::getStageNames() const {
+    std::vector<std::string> names;
+    for (auto& stage : m_stages) {
+        names.emplace_back(stage.first);
+    }
+
+    return names;
+}
+
 int ProcBase::getCenterX() const { return m_center.x; }
 
 int ProcBase::getCenterY() const { return m_center.y; }
@@ -4,6 +4,8 @@
 
 #include <stdint.h>
 
+#include <map>
+#include <string>
 #include <vector>
 
 #include <opencv2/core/core.hpp>
@@ -22,13 +24,30 @@ public:
      *
      * The data's pointer is copied and all image processing is done directly
      * to that buffer. Since a shallow copy is used, the buffer must exist for
-     * the duration of processing. An RGB image is expected.
+     * the duration of processing. An RGB image is expected, or a grayscale
+     * one if 'channels' is 1 and needsColor() returns false.
      */
-    void setImage(uint8_t* image, uint32_t width, uint32_t height);
+    void setImage(uint8_t* image, uint32_t width, uint32_t height,
+                  uint32_t channels = 3);
+
+    /* Returns false if the processor only uses the luma of the image, so it
+     * can be given grayscale images instead
+     */
+    virtual bool needsColor() const;
 
     // Processes provided image with the overriden functions
     void processImage();
 
+    /* Returns the region of the next image processImage() will read, or an
+     * empty rectangle if it will read all of it
+     */
+    virtual cv::Rect getNextRegion() const;
+
+    /* Tells the processor whether only the region returned by getNextRegion()
+     * is decoded in the next image. The rest of it holds stale pixels.
+     */
+    virtual void setRegionOnly(bool regionOnly);
+
     // Returns buffer used to contain OpenCV image
     uint8_t* getProcessedImage() const;
 
@@ -39,6 +58,21 @@ public:
 
     const std::vector<Target>& getTargetPositions() const;
 
+    /* Serializes getTargetPositions() into a compact record. All values are
+     * little-endian. It contains a uint16_t target count, then for each target
+     * a uint16_t point count followed by an int16_t x and y for each point.
+     */
+    void getTargetRecord(std::vector<uint8_t>& record) const;
+
+    /* Returns the intermediate image with the given name, or nullptr if the
+     * processor has no stage by that name. The image is only valid until the
+     * next call to processImage().
+     */
+    const cv::Mat* getStage(const std::string& name) const;
+
+    // Returns the names of the stages getStage() returns
+    std::vector<std::string> getStageNames() const;
+
     // Returns the center mass x-coord of the goal
     int getCenterX() const;
 
@@ -60,6 +94,13 @@ protected:
     // Prepared grayscale channel (output of prepareImage())
     cv::Mat m_grayChannel;
 
+    /* Intermediate images which can be retrieved by name with getStage().
+     * Processors which produce a different binary mask should replace the
+     * "mask" entry.
+     */
+    std::map<std::string, const cv::Mat*> m_stages{
+        {"prepared", &m_grayChannel}, {"mask", &m_grayChannel}};
+
     std::vector<Target> m_targets;
 
     // Returns center of mass of goal
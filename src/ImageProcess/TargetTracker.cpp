@@ -0,0 +1,88 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#include "TargetTracker.hpp"
+
+constexpr double TargetTracker::k_initialVelocityVariance;
+
+void TargetTracker::setNoise(double measurementNoise,
+                             double accelerationNoise) {
+    if (measurementNoise > 0.0) {
+        m_measurementVariance = measurementNoise * measurementNoise;
+    }
+    if (accelerationNoise > 0.0) {
+        m_accelerationVariance = accelerationNoise * accelerationNoise;
+    }
+}
+
+void TargetTracker::setDropoutTime(Clock::duration time) {
+    m_dropoutTime = time;
+}
+
+void TargetTracker::update(const cv::Point2f& position,
+                           Clock::time_point time) {
+    if (!isTracking(time) || time < m_lastTime) {
+        m_x.reset(position.x, m_measurementVariance,
+                  k_initialVelocityVariance);
+        m_y.reset(position.y, m_measurementVariance,
+                  k_initialVelocityVariance);
+        m_tracking = true;
+        m_lastTime = time;
+        return;
+    }
+
+    double dt = std::chrono::duration<double>(time - m_lastTime).count();
+    m_x.predict(dt, m_accelerationVariance);
+    m_y.predict(dt, m_accelerationVariance);
+    m_x.correct(position.x, m_measurementVariance);
+    m_y.correct(position.y, m_measurementVariance);
+    m_lastTime = time;
+}
+
+bool TargetTracker::isTracking(Clock::time_point time) const {
+    return m_tracking && time - m_lastTime <= m_dropoutTime;
+}
+
+cv::Point2f TargetTracker::predict(Clock::time_point time) const {
+    double dt = std::chrono::duration<double>(time - m_lastTime).count();
+    return cv::Point2f(m_x.position + m_x.velocity * dt,
+                       m_y.position + m_y.velocity * dt);
+}
+
+cv::Point2f TargetTracker::getVelocity() const {
+    return cv::Point2f(m_x.velocity, m_y.velocity);
+}
+
+void TargetTracker::Axis::reset(double z, double measurementVariance,
+                                double velocityVariance) {
+    position = z;
+    velocity = 0.0;
+    p00 = measurementVariance;
+    p01 = 0.0;
+    p11 = velocityVariance;
+}
+
+void TargetTracker::Axis::predict(double dt, double accelerationVariance) {
+    position += velocity * dt;
+
+    // P = F P F^T + Q for a piecewise constant acceleration
+    double dt2 = dt * dt;
+    p00 += 2.0 * dt * p01 + dt2 * p11 +
+           accelerationVariance * dt2 * dt2 / 4.0;
+    p01 += dt * p11 + accelerationVariance * dt2 * dt / 2.0;
+    p11 += accelerationVariance * dt2;
+}
+
+void TargetTracker::Axis::correct(double z, double measurementVariance) {
+    double innovation = z - position;
+    double s = p00 + measurementVariance;
+    double k0 = p00 / s;
+    double k1 = p01 / s;
+
+    position += k0 * innovation;
+    velocity += k1 * innovation;
+
+    // P = (I - K H) P
+    p11 -= k1 * p01;
+    p01 -= k0 * p01;
+    p00 -= k0 * p00;
+}
@@ -0,0 +1,78 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <chrono>
+
+#include <opencv2/core/core.hpp>
+
+/**
+ * Smooths a target's position with a constant-velocity Kalman filter
+ *
+ * Positions are timestamped with when their image was captured, so the
+ * filter can predict where the target is at any later time. This compensates
+ * for the time spent receiving, decoding, and processing the image, and keeps
+ * the target through frames in which it wasn't found.
+ */
+class TargetTracker {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /* 'measurementNoise' is the standard deviation of measured positions in
+     * pixels. 'accelerationNoise' is the standard deviation of the target's
+     * acceleration in pixels per second squared. Values which aren't positive
+     * are ignored.
+     */
+    void setNoise(double measurementNoise, double accelerationNoise);
+
+    /* Sets how long the target is kept after it was last measured. After
+     * that, the next measurement starts a new track.
+     */
+    void setDropoutTime(Clock::duration time);
+
+    // Incorporates a position measured in an image captured at 'time'
+    void update(const cv::Point2f& position, Clock::time_point time);
+
+    // Returns true if the target was measured within the dropout time
+    bool isTracking(Clock::time_point time) const;
+
+    /* Returns the predicted position at 'time'. Only valid if isTracking()
+     * returns true.
+     */
+    cv::Point2f predict(Clock::time_point time) const;
+
+    // Returns the estimated velocity in pixels per second
+    cv::Point2f getVelocity() const;
+
+private:
+    /* Position and velocity along one image axis along with their covariance.
+     * The axes are independent, so each is filtered separately.
+     */
+    struct Axis {
+        double position = 0.0;
+        double velocity = 0.0;
+        double p00 = 0.0;
+        double p01 = 0.0;
+        double p11 = 0.0;
+
+        void reset(double z, double measurementVariance,
+                   double velocityVariance);
+        void predict(double dt, double accelerationVariance);
+        void correct(double z, double measurementVariance);
+    };
+
+    // Initial velocity variance of a new track in (pixels/s)^2
+    static constexpr double k_initialVelocityVariance = 1e5;
+
+    Axis m_x;
+    Axis m_y;
+
+    double m_measurementVariance = 4.0;
+    double m_accelerationVariance = 250000.0;
+    Clock::duration m_dropoutTime = std::chrono::milliseconds(500);
+
+    bool m_tracking = false;
+
+    // Capture time of the last measurement, which the state is valid at
+    Clock::time_point m_lastTime;
+};
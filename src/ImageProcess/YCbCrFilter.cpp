@@ -0,0 +1,146 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#include "YCbCrFilter.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+/* Fixed-point offsets of each channel from luma, built the same way as
+ * libjpeg's build_ycc_rgb_table()
+ */
+struct Tables {
+    int crToR[256];
+    int cbToB[256];
+    int32_t cbToG[256];
+    int32_t crToG[256];
+
+    Tables() {
+        constexpr int k_scaleBits = 16;
+        constexpr int32_t k_oneHalf = 1 << (k_scaleBits - 1);
+        auto fix = [](double x) {
+            return static_cast<int32_t>(x * (1 << k_scaleBits) + 0.5);
+        };
+
+        for (int i = 0; i < 256; i++) {
+            int x = i - 128;
+            crToR[i] = (fix(1.40200) * x + k_oneHalf) >> k_scaleBits;
+            cbToB[i] = (fix(1.77200) * x + k_oneHalf) >> k_scaleBits;
+            crToG[i] = -fix(0.71414) * x;
+            cbToG[i] = -fix(0.34414) * x + k_oneHalf;
+        }
+    }
+};
+
+const Tables& getTables() {
+    static Tables tables;
+    return tables;
+}
+
+/* Sets each pixel of the mask row to 255 if its luma lies within its interval
+ * and returns the number of pixels which passed
+ */
+int filterLumaRow(const uint8_t* luma, const uint8_t* minLuma,
+                  const uint8_t* maxLuma, uint8_t* mask, int width) {
+    int count = 0;
+    int x = 0;
+#ifdef __SSE2__
+    for (; x + 16 <= width; x += 16) {
+        __m128i v =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(luma + x));
+        __m128i lo =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(minLuma + x));
+        __m128i hi =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(maxLuma + x));
+        __m128i pass = _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(v, lo), v),
+                                     _mm_cmpeq_epi8(_mm_min_epu8(v, hi), v));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(mask + x), pass);
+        count += __builtin_popcount(_mm_movemask_epi8(pass));
+    }
+#endif
+    for (; x < width; x++) {
+        uint8_t passed = (luma[x] >= minLuma[x]) & (luma[x] <= maxLuma[x]);
+        mask[x] = -passed;
+        count += passed;
+    }
+    return count;
+}
+
+}  // namespace
+
+void YCbCrFilter::setRange(const uint8_t lower[3], const uint8_t upper[3]) {
+    std::copy(lower, lower + 3, m_lower);
+    std::copy(upper, upper + 3, m_upper);
+}
+
+void YCbCrFilter::apply(const cv::Mat& y, const cv::Mat& cb,
+                        const cv::Mat& cr, cv::Mat& coarse, cv::Mat& mask,
+                        std::vector<int>& rowCounts) {
+    const Tables& tables = getTables();
+
+    coarse.create(cb.rows, cb.cols, CV_8UC1);
+    mask.create(y.rows, y.cols, CV_8UC1);
+    rowCounts.resize(y.rows);
+    m_minLuma.resize(2 * cb.cols);
+    m_maxLuma.resize(2 * cb.cols);
+
+    /* libjpeg clamps each channel to [0, 255], so bounds at either end of
+     * that range don't limit luma. They're widened to never be the tightest.
+     */
+    int lower[3];
+    int upper[3];
+    for (int c = 0; c < 3; c++) {
+        lower[c] = m_lower[c] > 0 ? m_lower[c] : -1024;
+        upper[c] = m_upper[c] < 255 ? m_upper[c] : 1024;
+    }
+
+    uint8_t* minLumaRow = m_minLuma.data();
+    uint8_t* maxLumaRow = m_maxLuma.data();
+    for (int cy = 0; cy < cb.rows; cy++) {
+        const uint8_t* cbRow = cb.ptr<uint8_t>(cy);
+        const uint8_t* crRow = cr.ptr<uint8_t>(cy);
+        uint8_t* coarseRow = coarse.ptr<uint8_t>(cy);
+
+        bool anyPassed = false;
+        for (int cx = 0; cx < cb.cols; cx++) {
+            // Offsets from luma in BGR order
+            int b = tables.cbToB[cbRow[cx]];
+            int g = (tables.cbToG[cbRow[cx]] + tables.crToG[crRow[cx]]) >> 16;
+            int r = tables.crToR[crRow[cx]];
+
+            int minLuma = std::max(
+                {0, lower[0] - b, lower[1] - g, lower[2] - r});
+            int maxLuma = std::min(
+                {255, upper[0] - b, upper[1] - g, upper[2] - r});
+
+            bool passed = minLuma <= maxLuma;
+            anyPassed |= passed;
+            coarseRow[cx] = passed ? 255 : 0;
+
+            // An empty interval is stored as one no luma can be in
+            minLuma = passed ? minLuma : 255;
+            maxLuma = passed ? maxLuma : 0;
+            minLumaRow[2 * cx] = minLumaRow[2 * cx + 1] = minLuma;
+            maxLumaRow[2 * cx] = maxLumaRow[2 * cx + 1] = maxLuma;
+        }
+
+        // Each chroma row covers two rows of luma
+        for (int row = 2 * cy; row < std::min(2 * cy + 2, y.rows); row++) {
+            uint8_t* maskRow = mask.ptr<uint8_t>(row);
+            if (!anyPassed) {
+                std::memset(maskRow, 0, y.cols);
+                rowCounts[row] = 0;
+                continue;
+            }
+
+            rowCounts[row] =
+                filterLumaRow(y.ptr<uint8_t>(row), minLumaRow, maxLumaRow,
+                              maskRow, y.cols);
+        }
+    }
+}
@@ -0,0 +1,43 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+/**
+ * Filters an image decoded to YCbCr planes into a binary mask of pixels whose
+ * BGR color lies within a range, without converting the image to BGR
+ *
+ * Each chroma sample fixes how much the pixels it covers are offset from
+ * their luma in each BGR channel, so the range becomes an interval of luma
+ * per chroma sample. Chroma is classified first at a quarter of the
+ * resolution; rows of pixels are only compared against their intervals if
+ * some chroma sample in the row admits any luma. The offsets match libjpeg's
+ * YCbCr to RGB conversion, so pixels pass exactly when the BGR image libjpeg
+ * would produce without fancy upsampling passes ColorFilter.
+ */
+class YCbCrFilter {
+public:
+    // Sets the range of colors which pass in BGR order, like ColorFilter
+    void setRange(const uint8_t lower[3], const uint8_t upper[3]);
+
+    /* 'y' is the full-resolution luma plane. 'cb' and 'cr' are subsampled by
+     * 2 in both directions, with their sizes rounded up. 'coarse' is set to
+     * 255 where a chroma sample admits some luma. 'mask' and 'rowCounts'
+     * receive the full-resolution result like ColorFilter::apply().
+     */
+    void apply(const cv::Mat& y, const cv::Mat& cb, const cv::Mat& cr,
+               cv::Mat& coarse, cv::Mat& mask, std::vector<int>& rowCounts);
+
+private:
+    uint8_t m_lower[3] = {0, 0, 0};
+    uint8_t m_upper[3] = {255, 255, 255};
+
+    // Luma interval of each pixel in the current pair of rows
+    std::vector<uint8_t> m_minLuma;
+    std::vector<uint8_t> m_maxLuma;
+};
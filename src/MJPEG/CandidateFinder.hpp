@@ -0,0 +1,34 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+/**
+ * Chooses which parts of an image are worth decoding from a thumbnail of it
+ *
+ * The thumbnail is built from the DC coefficient of each block of the JPEG,
+ * which is the block's average color, so it costs no full IDCTs. Only the
+ * rows of blocks found to contain candidates are then decoded at full
+ * resolution.
+ */
+class CandidateFinder {
+public:
+    virtual ~CandidateFinder() = default;
+
+    /* Returns false if findCandidates() would pick every row, so the image is
+     * decoded in full without a thumbnail
+     */
+    virtual bool wantsThumbnail() const = 0;
+
+    /* 'thumbnail' has one pixel for each 8x8 block of the image, with
+     * 'channels' bytes per pixel in the same format the decoder produces.
+     * 'candidateRows' has an entry for each row of the thumbnail, initially
+     * false. Entries of rows which may contain a target should be set to true.
+     */
+    virtual void findCandidates(const uint8_t* thumbnail, unsigned int width,
+                                unsigned int height, unsigned int channels,
+                                std::vector<bool>& candidateRows) = 0;
+};
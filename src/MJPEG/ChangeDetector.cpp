@@ -0,0 +1,73 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#include "ChangeDetector.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+constexpr unsigned int ChangeDetector::k_blockSize;
+constexpr unsigned int ChangeDetector::k_sampleStep;
+
+void ChangeDetector::setThreshold(int threshold) {
+    m_threshold = std::max(0, std::min(threshold, 255));
+    reset();
+}
+
+int ChangeDetector::getThreshold() const { return m_threshold; }
+
+bool ChangeDetector::isChanged(const uint8_t* image, unsigned int width,
+                               unsigned int height, unsigned int channels) {
+    if (m_threshold == 0) {
+        return true;
+    }
+
+    unsigned int blocksPerRow = (width + k_blockSize - 1) / k_blockSize;
+    unsigned int blockRows = (height + k_blockSize - 1) / k_blockSize;
+
+    // A new geometry invalidates the reference and the sample counts
+    bool isNewGeometry =
+        width != m_width || height != m_height || channels != m_channels;
+    if (isNewGeometry) {
+        m_width = width;
+        m_height = height;
+        m_channels = channels;
+        m_reference.clear();
+        m_counts.assign(blocksPerRow * blockRows, 0);
+    }
+    m_sums.assign(blocksPerRow * blockRows, 0);
+
+    for (unsigned int y = 0; y < height; y += k_sampleStep) {
+        const uint8_t* row = image + y * width * channels;
+        uint32_t* sums = &m_sums[(y / k_blockSize) * blocksPerRow];
+        uint32_t* counts = &m_counts[(y / k_blockSize) * blocksPerRow];
+
+        for (unsigned int x = 0; x < width; x += k_sampleStep) {
+            const uint8_t* pixel = row + x * channels;
+            uint32_t sum = 0;
+            for (unsigned int c = 0; c < channels; c++) {
+                sum += pixel[c];
+            }
+
+            sums[x / k_blockSize] += sum;
+            if (isNewGeometry) {
+                counts[x / k_blockSize] += channels;
+            }
+        }
+    }
+
+    bool changed = m_reference.empty();
+    for (size_t i = 0; !changed && i < m_sums.size(); i++) {
+        uint32_t diff = std::abs(static_cast<int64_t>(m_sums[i]) -
+                                 static_cast<int64_t>(m_reference[i]));
+        changed = diff > static_cast<uint32_t>(m_threshold) * m_counts[i];
+    }
+
+    // Unchanged images aren't kept so slow drift still accumulates
+    if (changed) {
+        std::swap(m_reference, m_sums);
+    }
+
+    return changed;
+}
+
+void ChangeDetector::reset() { m_reference.clear(); }
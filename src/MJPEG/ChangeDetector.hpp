@@ -0,0 +1,52 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+/**
+ * Decides whether an image differs enough from the last one reported as
+ * changed to be worth encoding and sending again
+ *
+ * The image is divided into 16x16 pixel blocks and each block is summarized
+ * by the sum of every fourth pixel of every fourth row. An image has changed
+ * when the mean of any block moves by more than the threshold. Comparing
+ * block means rather than a hash ignores sensor noise while still catching
+ * small moving objects.
+ */
+class ChangeDetector {
+public:
+    /* Sets the largest change in a block's mean intensity (0 to 255) which is
+     * ignored. A threshold of 0 reports every image as changed.
+     */
+    void setThreshold(int threshold);
+    int getThreshold() const;
+
+    /* Returns true if the image differs from the last one for which true was
+     * returned. 'channels' is the number of bytes per pixel.
+     */
+    bool isChanged(const uint8_t* image, unsigned int width,
+                   unsigned int height, unsigned int channels);
+
+    // Forgets the reference image so the next one is reported as changed
+    void reset();
+
+private:
+    static constexpr unsigned int k_blockSize = 16;
+    static constexpr unsigned int k_sampleStep = 4;
+
+    int m_threshold = 0;
+
+    unsigned int m_width = 0;
+    unsigned int m_height = 0;
+    unsigned int m_channels = 0;
+
+    // Block sums of the reference image and of the image being tested
+    std::vector<uint32_t> m_reference;
+    std::vector<uint32_t> m_sums;
+
+    // Number of samples summed in each block
+    std::vector<uint32_t> m_counts;
+};
@@ -2,6 +2,58 @@
 
 #include "ClientBase.hpp"
 
+#include "../Metrics.hpp"
+
+std::chrono::steady_clock::time_point ClientBase::getReceiveTime() const {
+    return m_receiveTime;
+}
+
+void ClientBase::setScanlineSink(ScanlineSink* sink) { m_scanlineSink = sink; }
+
+void ClientBase::setCandidateFinder(CandidateFinder* finder) {
+    m_candidateFinder = finder;
+}
+
+void ClientBase::setDecodeWindow(unsigned int x, unsigned int y,
+                                 unsigned int width, unsigned int height) {
+    // A duplicate of the last JPEG may have been decoded with another window
+    if (x != m_windowX || y != m_windowY || width != m_windowWidth ||
+        height != m_windowHeight) {
+        m_duplicateDetector.reset();
+    }
+
+    m_windowX = x;
+    m_windowY = y;
+    m_windowWidth = width;
+    m_windowHeight = height;
+}
+
+void ClientBase::setGrayscale(bool grayscale) {
+    if (grayscale != m_grayscale) {
+        m_duplicateDetector.reset();
+    }
+
+    m_grayscale = grayscale;
+}
+
+bool ClientBase::isGrayscale() const { return m_grayscale; }
+
+void ClientBase::setChromaPlanes(bool chromaPlanes) {
+    if (chromaPlanes != m_chromaPlanes) {
+        m_duplicateDetector.reset();
+    }
+
+    m_chromaPlanes = chromaPlanes;
+}
+
+bool ClientBase::hasChromaPlanes() const {
+    return m_grayscale && m_chromaPlanes;
+}
+
+void ClientBase::setSkipDuplicates(bool skipDuplicates) {
+    m_skipDuplicates = skipDuplicates;
+}
+
 void ClientBase::setObject(VideoStream* object) { m_object = object; }
 
 void ClientBase::setNewImageCallback(
@@ -17,10 +69,55 @@ void ClientBase::setStopCallback(void (VideoStream::*stopCbk)()) {
     m_stopCbk = stopCbk;
 }
 
+void ClientBase::setRepeatedImageCallback(
+    void (VideoStream::*repeatedImageCbk)()) {
+    m_repeatedImageCbk = repeatedImageCbk;
+}
+
 void ClientBase::callNewImage(uint8_t* buf, int bufsize) {
     (m_object->*m_newImageCbk)(buf, bufsize);
 }
 
-void ClientBase::callStart() { (m_object->*m_startCbk)(); }
+void ClientBase::callStart() {
+    // The first image of each stream must reach the callback
+    m_duplicateDetector.reset();
+
+    (m_object->*m_startCbk)();
+}
 
 void ClientBase::callStop() { (m_object->*m_stopCbk)(); }
+
+void ClientBase::callRepeatedImage() { (m_object->*m_repeatedImageCbk)(); }
+
+bool ClientBase::isDuplicate(const uint8_t* data, size_t size) {
+    if (!m_skipDuplicates || !m_duplicateDetector.isDuplicate(data, size)) {
+        return false;
+    }
+
+    Metrics::add(Metrics::Counter::duplicatesSkipped);
+    return true;
+}
+
+bool ClientBase::jpeg_load_from_memory(uint8_t* inputBuf, int inputLen,
+                                       std::vector<uint8_t>& outputBuf) {
+    m_decoder.setGrayscale(m_grayscale);
+    m_decoder.setChromaPlanes(m_chromaPlanes);
+    m_decoder.setCandidateFinder(m_candidateFinder);
+    m_decoder.setWindow(m_windowX, m_windowY, m_windowWidth, m_windowHeight);
+    if (!m_decoder.decode(inputBuf, inputLen, outputBuf, m_scanlineSink)) {
+        return false;
+    }
+
+    /* Part of the image is stale or blocky, so a duplicate of this JPEG must
+     * be decoded again once it can be decoded in full
+     */
+    if (!m_decoder.isComplete()) {
+        m_duplicateDetector.reset();
+    }
+
+    m_imgWidth = m_decoder.getWidth();
+    m_imgHeight = m_decoder.getHeight();
+    m_imgChannels = m_decoder.getChannels();
+
+    return true;
+}
@@ -4,8 +4,15 @@
 
 #include <stdint.h>
 
+#include <chrono>
 #include <string>
+#include <vector>
 
+#include "DuplicateDetector.hpp"
+#include "JpegDecoder.hpp"
+
+class CandidateFinder;
+class ScanlineSink;
 class VideoStream;
 
 /**
@@ -34,21 +41,92 @@ public:
      */
     virtual uint8_t* getCurrentImage() = 0;
 
-    // Returns size of image currently in secondary buffer
+    // Returns size and channels of image currently in secondary buffer
     virtual unsigned int getCurrentWidth() const = 0;
     virtual unsigned int getCurrentHeight() const = 0;
+    virtual unsigned int getCurrentChannels() const = 0;
+
+    /* Returns the time at which the most recent image was received, before it
+     * was decompressed. This is only valid from within the new image callback.
+     */
+    std::chrono::steady_clock::time_point getReceiveTime() const;
+
+    /* Gives the sink every row of each JPEG as it's decoded. Clients which
+     * don't decode JPEGs themselves ignore it. This must be called before
+     * start().
+     */
+    void setScanlineSink(ScanlineSink* sink);
+
+    /* Lets the finder pick which rows of each JPEG are decoded from a
+     * thumbnail of it. Rows it doesn't pick are filled with the average color
+     * of each 8x8 block. Clients which don't decode JPEGs themselves ignore
+     * it. This must be called before start().
+     */
+    void setCandidateFinder(CandidateFinder* finder);
+
+    /* Limits decoding of the following JPEGs to the window of 'width' x
+     * 'height' pixels at ('x', 'y'). The rest of each image keeps the pixels
+     * of the last image which had them decoded, so coordinates in the window
+     * are unchanged. Whole images are decoded until the first one arrives and
+     * whenever their size changes. A width or height of 0 decodes whole
+     * images. This may be called before start() or from the new image
+     * callback. Clients which don't decode JPEGs themselves ignore it.
+     */
+    void setDecodeWindow(unsigned int x, unsigned int y, unsigned int width,
+                         unsigned int height);
+
+    /* If true, images are provided in grayscale instead of RGB, which skips
+     * decoding their color. This may be called before start() or from the new
+     * image callback, in which case it applies to the following images.
+     */
+    void setGrayscale(bool grayscale);
+    bool isGrayscale() const;
+
+    /* If true along with setGrayscale(), each image's luma is followed by its
+     * Cb and Cr planes at half the width and height, rounded up, so color can
+     * still be classified without converting to RGB. Clients whose images are
+     * already decoded convert them to JPEG's YCbCr. This must be called before
+     * start().
+     */
+    void setChromaPlanes(bool chromaPlanes);
+    bool hasChromaPlanes() const;
+
+    /* If true, JPEGs identical to the one before them aren't decoded. The
+     * repeated image callback is called for them instead of the new image
+     * callback, since the last image and its results are still current. A
+     * duplicate is still decoded if the decoding options changed or the last
+     * image was only decoded in part. Clients which don't decode JPEGs
+     * themselves ignore it. This must be called before start().
+     */
+    void setSkipDuplicates(bool skipDuplicates);
 
     void setObject(VideoStream* object);
     void setNewImageCallback(void (VideoStream::*newImageCbk)(uint8_t* buf,
                                                               int bufsize));
     void setStartCallback(void (VideoStream::*startCbk)());
     void setStopCallback(void (VideoStream::*stopCbk)());
+    void setRepeatedImageCallback(void (VideoStream::*repeatedImageCbk)());
 
     void callNewImage(uint8_t* buf, int bufsize);
     void callStart();
     void callStop();
+    void callRepeatedImage();
 
 protected:
+    /* Returns true if duplicates are skipped and the JPEG is identical to the
+     * one before it, and counts it as skipped. The caller should then call
+     * callRepeatedImage() instead of decoding it.
+     */
+    bool isDuplicate(const uint8_t* data, size_t size);
+
+    /* Decompresses JPEG data into 'outputBuf' with the decoding options set
+     * on this client. The image's dimensions are stored in m_imgWidth,
+     * m_imgHeight, and m_imgChannels. Returns true if decompressed
+     * successfully.
+     */
+    bool jpeg_load_from_memory(uint8_t* inputBuf, int inputLen,
+                               std::vector<uint8_t>& outputBuf);
+
     VideoStream* m_object = nullptr;
 
     // Called if the new image loaded successfully
@@ -59,4 +137,35 @@ protected:
 
     // Called when client thread stops
     void (VideoStream::*m_stopCbk)() = nullptr;
+
+    // Called instead of m_newImageCbk when a duplicate image is skipped
+    void (VideoStream::*m_repeatedImageCbk)() = nullptr;
+
+    // Set by the client thread when an image arrives
+    std::chrono::steady_clock::time_point m_receiveTime;
+
+    // Receives decoded rows if it isn't nullptr
+    ScanlineSink* m_scanlineSink = nullptr;
+
+    // Picks rows to decode if it isn't nullptr
+    CandidateFinder* m_candidateFinder = nullptr;
+
+    // Part of each image to decode, or the whole image if it's empty
+    unsigned int m_windowX = 0;
+    unsigned int m_windowY = 0;
+    unsigned int m_windowWidth = 0;
+    unsigned int m_windowHeight = 0;
+
+    bool m_grayscale = false;
+    bool m_chromaPlanes = false;
+
+    bool m_skipDuplicates = false;
+    DuplicateDetector m_duplicateDetector;
+
+    JpegDecoder m_decoder;
+
+    // Dimensions of the most recently received image
+    unsigned int m_imgWidth = 0;
+    unsigned int m_imgHeight = 0;
+    unsigned int m_imgChannels = 0;
 };
@@ -0,0 +1,45 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#include "DuplicateDetector.hpp"
+
+#include <cstring>
+
+constexpr size_t DuplicateDetector::k_samples;
+
+bool DuplicateDetector::isDuplicate(const uint8_t* data, size_t size) {
+    uint64_t hash = hashSamples(data, size);
+    if (!m_frame.empty() && hash == m_hash && size == m_frame.size() &&
+        std::memcmp(data, &m_frame[0], size) == 0) {
+        return true;
+    }
+
+    m_hash = hash;
+    m_frame.assign(data, data + size);
+    return false;
+}
+
+void DuplicateDetector::reset() {
+    m_hash = 0;
+    m_frame.clear();
+}
+
+uint64_t DuplicateDetector::hashSamples(const uint8_t* data, size_t size) {
+    // 64-bit FNV-1a
+    constexpr uint64_t k_offsetBasis = 14695981039346656037ull;
+    constexpr uint64_t k_prime = 1099511628211ull;
+
+    uint64_t hash = (k_offsetBasis ^ size) * k_prime;
+    if (size == 0) {
+        return hash;
+    }
+
+    /* The samples span the whole frame. Frames from the same camera share
+     * their headers, but those are small, so most samples fall in the
+     * entropy-coded data.
+     */
+    for (size_t i = 0; i < k_samples; i++) {
+        hash = (hash ^ data[i * (size - 1) / (k_samples - 1)]) * k_prime;
+    }
+
+    return hash;
+}
@@ -0,0 +1,39 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+/**
+ * Decides whether a compressed frame is identical to the one before it
+ *
+ * Cameras resend the same JPEG when their encoder stalls or the scene hasn't
+ * changed. Such frames would decode to the image already held by the client,
+ * so decoding them again is wasted work. Frames are first compared by their
+ * size and a hash of bytes sampled across them, which rejects nearly every
+ * new frame without reading all of it. Frames which pass are then compared
+ * byte for byte, so only exact duplicates are reported.
+ */
+class DuplicateDetector {
+public:
+    /* Returns true if the frame is identical to the last one given. Otherwise,
+     * the frame is kept for comparison with the next one.
+     */
+    bool isDuplicate(const uint8_t* data, size_t size);
+
+    // Forgets the last frame so the next one isn't a duplicate
+    void reset();
+
+private:
+    // Number of bytes sampled evenly across each frame for its hash
+    static constexpr size_t k_samples = 64;
+
+    // Returns a hash of the frame's size and the sampled bytes
+    static uint64_t hashSamples(const uint8_t* data, size_t size);
+
+    uint64_t m_hash = 0;
+    std::vector<uint8_t> m_frame;
+};
@@ -0,0 +1,47 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#include "FrameRecord.hpp"
+
+constexpr uint32_t FrameRecord::k_magic;
+constexpr size_t FrameRecord::k_headerSize;
+constexpr uint32_t FrameRecord::k_maxPayload;
+
+namespace {
+
+void write32(uint8_t* buf, uint32_t value) {
+    buf[0] = value >> 24;
+    buf[1] = value >> 16;
+    buf[2] = value >> 8;
+    buf[3] = value;
+}
+
+uint32_t read32(const uint8_t* buf) {
+    return (static_cast<uint32_t>(buf[0]) << 24) | (buf[1] << 16) |
+           (buf[2] << 8) | buf[3];
+}
+
+}  // namespace
+
+void FrameRecord::pack(uint8_t* buf) const {
+    write32(buf, k_magic);
+    write32(buf + 4, frameId);
+    write32(buf + 8, timestamp >> 32);
+    write32(buf + 12, timestamp);
+    write32(buf + 16, targetsSize);
+    write32(buf + 20, jpegSize);
+}
+
+bool FrameRecord::unpack(const uint8_t* buf) {
+    if (read32(buf) != k_magic) {
+        return false;
+    }
+
+    frameId = read32(buf + 4);
+    timestamp = (static_cast<uint64_t>(read32(buf + 8)) << 32) |
+                read32(buf + 12);
+    targetsSize = read32(buf + 16);
+    jpegSize = read32(buf + 20);
+
+    return targetsSize <= k_maxPayload && jpegSize > 0 &&
+           jpegSize <= k_maxPayload;
+}
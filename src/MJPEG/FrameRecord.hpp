@@ -0,0 +1,38 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Header which precedes each frame sent on MjpegServer's record stream
+ *
+ * A record is this header followed by 'targetsSize' bytes of target record
+ * (see ProcBase::getTargetRecord()) and then 'jpegSize' bytes of JPEG. The
+ * header is serialized in network byte order.
+ */
+struct FrameRecord {
+    static constexpr uint32_t k_magic = 0x494E5352;  // "INSR"
+    static constexpr size_t k_headerSize = 24;
+
+    // Records claiming a larger target record or JPEG are rejected as corrupt
+    static constexpr uint32_t k_maxPayload = 16 * 1024 * 1024;
+
+    // Incremented for each image served on the stream
+    uint32_t frameId = 0;
+
+    // Time the image was captured in microseconds since the Unix epoch
+    uint64_t timestamp = 0;
+
+    uint32_t targetsSize = 0;
+    uint32_t jpegSize = 0;
+
+    // Writes the header into the first k_headerSize bytes of 'buf'
+    void pack(uint8_t* buf) const;
+
+    /* Reads the header from the first k_headerSize bytes of 'buf'. Returns
+     * false if it isn't a record header or its sizes are implausible.
+     */
+    bool unpack(const uint8_t* buf);
+};
@@ -0,0 +1,156 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#include "H264Encoder.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+extern "C" {
+#include <libavutil/opt.h>
+}
+
+H264Encoder::H264Encoder(int bitrate, int keyframeInterval)
+    : m_bitrate(bitrate), m_keyframeInterval(keyframeInterval) {}
+
+H264Encoder::~H264Encoder() { close(); }
+
+void H264Encoder::forceKeyframe() { m_forceKeyframe = true; }
+
+bool H264Encoder::encode(const uint8_t* image, unsigned int width,
+                         unsigned int height, std::vector<uint8_t>& out,
+                         bool& keyframe) {
+    // If opening failed, don't retry until the size changes
+    if (width != m_width || height != m_height) {
+        close();
+        m_width = width;
+        m_height = height;
+        if (!open(width, height)) {
+            return false;
+        }
+    } else if (m_context == nullptr) {
+        return false;
+    }
+
+    if (av_frame_make_writable(m_frame) < 0) {
+        return false;
+    }
+
+    const uint8_t* srcData[1] = {image};
+    int srcStride[1] = {static_cast<int>(width * 3)};
+    sws_scale(m_converter, srcData, srcStride, 0, height, m_frame->data,
+              m_frame->linesize);
+
+    /* Timestamps follow the time frames are actually served so rate control
+     * stays correct when the frame rate varies
+     */
+    int64_t pts = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::steady_clock::now() - m_startTime)
+                      .count();
+    m_frame->pts = std::max(pts, m_lastPts + 1);
+    m_lastPts = m_frame->pts;
+
+    m_frame->pict_type = m_forceKeyframe.exchange(false)
+                             ? AV_PICTURE_TYPE_I
+                             : AV_PICTURE_TYPE_NONE;
+
+    if (avcodec_send_frame(m_context, m_frame) < 0) {
+        return false;
+    }
+
+    // With zero latency tuning, each frame sent produces its packet right away
+    out.clear();
+    keyframe = false;
+    while (true) {
+        int error = avcodec_receive_packet(m_context, m_packet);
+        if (error == AVERROR(EAGAIN) || error == AVERROR_EOF) {
+            break;
+        } else if (error < 0) {
+            return false;
+        }
+
+        out.insert(out.end(), m_packet->data, m_packet->data + m_packet->size);
+        keyframe |= (m_packet->flags & AV_PKT_FLAG_KEY) != 0;
+        av_packet_unref(m_packet);
+    }
+
+    return true;
+}
+
+bool H264Encoder::open(unsigned int width, unsigned int height) {
+    // Prefer x264, but accept any other H.264 encoder libavcodec has
+    const AVCodec* codec = avcodec_find_encoder_by_name("libx264");
+    if (codec == nullptr) {
+        codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+    }
+    if (codec == nullptr) {
+        std::cout << "H264Encoder: no H.264 encoder available\n";
+        return false;
+    }
+
+    m_context = avcodec_alloc_context3(codec);
+    if (m_context == nullptr) {
+        return false;
+    }
+
+    // 4:2:0 chroma subsampling requires even dimensions
+    m_context->width = width & ~1u;
+    m_context->height = height & ~1u;
+    m_context->pix_fmt = AV_PIX_FMT_YUV420P;
+    m_context->time_base = AVRational{1, 1000};
+    m_context->bit_rate = m_bitrate * 1000;
+    m_context->rc_max_rate = m_context->bit_rate;
+
+    // A small VBV buffer keeps individual frames from bursting far over budget
+    m_context->rc_buffer_size = m_context->bit_rate / 4;
+    m_context->gop_size = m_keyframeInterval;
+    m_context->max_b_frames = 0;
+
+    av_opt_set(m_context->priv_data, "preset", "ultrafast", 0);
+    av_opt_set(m_context->priv_data, "tune", "zerolatency", 0);
+
+    // Make forced keyframes IDR frames so new viewers can start at them
+    av_opt_set(m_context->priv_data, "forced-idr", "1", 0);
+
+    if (avcodec_open2(m_context, codec, nullptr) < 0) {
+        std::cout << "H264Encoder: failed to open encoder\n";
+        close();
+        return false;
+    }
+
+    m_frame = av_frame_alloc();
+    m_packet = av_packet_alloc();
+    if (m_frame == nullptr || m_packet == nullptr) {
+        close();
+        return false;
+    }
+
+    m_frame->format = m_context->pix_fmt;
+    m_frame->width = m_context->width;
+    m_frame->height = m_context->height;
+    if (av_frame_get_buffer(m_frame, 0) < 0) {
+        close();
+        return false;
+    }
+
+    m_converter = sws_getContext(width, height, AV_PIX_FMT_BGR24,
+                                 m_context->width, m_context->height,
+                                 AV_PIX_FMT_YUV420P, SWS_FAST_BILINEAR,
+                                 nullptr, nullptr, nullptr);
+    if (m_converter == nullptr) {
+        close();
+        return false;
+    }
+
+    m_startTime = std::chrono::steady_clock::now();
+    m_lastPts = -1;
+
+    return true;
+}
+
+void H264Encoder::close() {
+    sws_freeContext(m_converter);
+    m_converter = nullptr;
+    av_frame_free(&m_frame);
+    av_packet_free(&m_packet);
+    avcodec_free_context(&m_context);
+}
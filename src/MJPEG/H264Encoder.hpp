@@ -0,0 +1,68 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+}
+
+/**
+ * Compresses BGR images into an H.264 Annex-B byte stream with libavcodec
+ *
+ * The encoder is tuned for latency rather than efficiency: no B-frames, no
+ * lookahead, and a short keyframe interval so new viewers can start decoding
+ * quickly. Each call to encode() produces one complete access unit.
+ */
+class H264Encoder {
+public:
+    /* 'bitrate' is the target bitrate in kilobits per second.
+     * 'keyframeInterval' is the maximum number of frames between keyframes.
+     */
+    H264Encoder(int bitrate, int keyframeInterval);
+    virtual ~H264Encoder();
+
+    H264Encoder(const H264Encoder&) = delete;
+    H264Encoder& operator=(const H264Encoder&) = delete;
+
+    // Makes the next frame a keyframe. This may be called from any thread.
+    void forceKeyframe();
+
+    /* Compresses the image into 'out'. 'keyframe' is set to true if decoding
+     * can start with this frame. Returns false if the image couldn't be
+     * encoded. The encoder is reopened if the image size changes.
+     */
+    bool encode(const uint8_t* image, unsigned int width, unsigned int height,
+                std::vector<uint8_t>& out, bool& keyframe);
+
+private:
+    int m_bitrate;
+    int m_keyframeInterval;
+    std::atomic<bool> m_forceKeyframe{false};
+
+    unsigned int m_width = 0;
+    unsigned int m_height = 0;
+
+    AVCodecContext* m_context = nullptr;
+    AVFrame* m_frame = nullptr;
+    AVPacket* m_packet = nullptr;
+
+    // Converts BGR to the encoder's YUV 4:2:0 input
+    SwsContext* m_converter = nullptr;
+
+    // Time of the first frame; timestamps are milliseconds since then
+    std::chrono::steady_clock::time_point m_startTime;
+    int64_t m_lastPts = -1;
+
+    // Opens the encoder for images of the given size
+    bool open(unsigned int width, unsigned int height);
+
+    // Frees the encoder
+    void close();
+};
@@ -0,0 +1,458 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#include "JpegDecoder.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "../Metrics.hpp"
+
+constexpr unsigned int JpegDecoder::k_batchRows;
+constexpr unsigned int JpegDecoder::k_fullDecodeFrames;
+
+JpegDecoder::JpegDecoder() {
+    m_cinfo.err = jpeg_std_error(&m_jerr);
+    jpeg_create_decompress(&m_cinfo);
+}
+
+JpegDecoder::~JpegDecoder() { jpeg_destroy_decompress(&m_cinfo); }
+
+bool JpegDecoder::decode(uint8_t* data, size_t size,
+                         std::vector<uint8_t>& image, ScanlineSink* sink) {
+    // JPEG images start with bytes 0xFF, 0xD8 and end with bytes 0xFF, 0xD9.
+    // Don't process data that isn't JPEG.
+    if (size < 2 || data[0] != 0xFF || data[1] != 0xD8) {
+        std::cout << "JpegDecoder: invalid magic: " << std::hex << "0x"
+                  << static_cast<uint32_t>(size > 0 ? data[0] : 0) << ", "
+                  << "0x" << static_cast<uint32_t>(size > 1 ? data[1] : 0)
+                  << std::dec << std::endl;
+        return false;
+    }
+
+    jpeg_mem_src(&m_cinfo, data, size);
+    if (jpeg_read_header(&m_cinfo, TRUE) != JPEG_HEADER_OK) {
+        return false;
+    }
+    m_complete = true;
+
+    // jpeg_read_header() resets these, so they must be set after it
+    m_cinfo.do_fancy_upsampling = FALSE;
+    m_cinfo.do_block_smoothing = FALSE;
+    if (m_grayscale) {
+        m_cinfo.out_color_space = JCS_GRAYSCALE;
+    }
+
+    /* Raw data output and the thumbnail require luma to be sampled at full
+     * resolution
+     */
+    bool fullLuma =
+        m_cinfo.num_components == 3 &&
+        m_cinfo.jpeg_color_space == JCS_YCbCr &&
+        m_cinfo.comp_info[0].h_samp_factor == m_cinfo.max_h_samp_factor &&
+        m_cinfo.comp_info[0].v_samp_factor == m_cinfo.max_v_samp_factor;
+
+    bool chromaPlanes = m_grayscale && m_chromaPlanes;
+    if (chromaPlanes && fullLuma) {
+        decodeRaw(image, sink);
+        return true;
+    }
+
+    if (m_windowWidth > 0 && m_windowHeight > 0 && !chromaPlanes) {
+        // The rest of the image is only valid if it's the same size
+        jpeg_calc_output_dimensions(&m_cinfo);
+        if (image.size() == m_cinfo.output_width * m_cinfo.output_height *
+                                m_cinfo.out_color_components) {
+            decodeWindow(image);
+            return true;
+        }
+    }
+
+    if (m_candidateFinder != nullptr && !m_grayscale && fullLuma &&
+        m_candidateFinder->wantsThumbnail()) {
+        if (m_fullDecodesLeft == 0) {
+            decodeCandidates(data, size, image, sink);
+            return true;
+        }
+        m_fullDecodesLeft--;
+    }
+
+    jpeg_start_decompress(&m_cinfo);
+
+    m_width = m_cinfo.output_width;
+    m_height = m_cinfo.output_height;
+    m_channels = m_cinfo.output_components;
+    unsigned int stride = m_width * m_channels;
+
+    // Size of both chroma planes
+    unsigned int chromaSize = 0;
+    if (chromaPlanes) {
+        chromaSize = 2 * ((m_width + 1) / 2) * ((m_height + 1) / 2);
+    }
+
+    // Change size of output buffer if necessary
+    if (image.size() != stride * m_height + chromaSize) {
+        image.resize(stride * m_height + chromaSize);
+    }
+
+    if (sink != nullptr) {
+        sink->beginImage(m_width, m_height, m_channels);
+    }
+
+    while (m_cinfo.output_scanline < m_cinfo.output_height) {
+        unsigned int firstRow = m_cinfo.output_scanline;
+        unsigned int numRows = std::min(k_batchRows, m_height - firstRow);
+
+        uint8_t* batch = image.data() + firstRow * stride;
+        for (unsigned int i = 0; i < numRows; i++) {
+            m_rows[i] = batch + i * stride;
+        }
+
+        // The decoder may return fewer rows than requested
+        numRows = jpeg_read_scanlines(&m_cinfo, m_rows, numRows);
+
+        if (sink != nullptr) {
+            sink->processRows(batch, firstRow, numRows, stride);
+        }
+    }
+
+    if (sink != nullptr) {
+        sink->endImage();
+    }
+
+    jpeg_finish_decompress(&m_cinfo);
+
+    // Chroma which couldn't be decoded raw is left neutral
+    if (chromaSize > 0) {
+        std::memset(image.data() + stride * m_height, 128, chromaSize);
+    }
+
+    return true;
+}
+
+void JpegDecoder::decodeRaw(std::vector<uint8_t>& image, ScanlineSink* sink) {
+    // jpeg_read_header() resets raw_data_out for every image
+    m_cinfo.raw_data_out = TRUE;
+    m_cinfo.out_color_space = JCS_YCbCr;
+    jpeg_start_decompress(&m_cinfo);
+
+    m_width = m_cinfo.output_width;
+    m_height = m_cinfo.output_height;
+    m_channels = 1;
+
+    unsigned int chromaWidth = (m_width + 1) / 2;
+    unsigned int chromaHeight = (m_height + 1) / 2;
+    unsigned int chromaSize = chromaWidth * chromaHeight;
+    if (image.size() != m_width * m_height + 2 * chromaSize) {
+        image.resize(m_width * m_height + 2 * chromaSize);
+    }
+    uint8_t* planes[3] = {image.data(), image.data() + m_width * m_height,
+                          image.data() + m_width * m_height + chromaSize};
+
+    /* jpeg_read_raw_data() returns one iMCU row at a time: v_samp_factor
+     * blocks of rows for each component, padded to whole blocks
+     */
+    unsigned int maxH = m_cinfo.max_h_samp_factor;
+    unsigned int maxV = m_cinfo.max_v_samp_factor;
+    unsigned int imcuRows = maxV * DCTSIZE;
+
+    size_t bufSize = 0;
+    unsigned int numRows = 0;
+    for (int c = 0; c < 3; c++) {
+        auto& comp = m_cinfo.comp_info[c];
+        bufSize +=
+            comp.width_in_blocks * DCTSIZE * comp.v_samp_factor * DCTSIZE;
+        numRows += comp.v_samp_factor * DCTSIZE;
+    }
+    if (m_rawBuf.size() < bufSize) {
+        m_rawBuf.resize(bufSize);
+    }
+    m_rawRows.resize(numRows);
+
+    JSAMPARRAY componentRows[3];
+    uint8_t* buf = m_rawBuf.data();
+    JSAMPROW* rows = m_rawRows.data();
+    for (int c = 0; c < 3; c++) {
+        auto& comp = m_cinfo.comp_info[c];
+        componentRows[c] = rows;
+        for (int i = 0; i < comp.v_samp_factor * DCTSIZE; i++) {
+            *rows++ = buf;
+            buf += comp.width_in_blocks * DCTSIZE;
+        }
+    }
+
+    if (sink != nullptr) {
+        sink->beginImage(m_width, m_height, m_channels);
+    }
+
+    while (m_cinfo.output_scanline < m_cinfo.output_height) {
+        unsigned int firstRow = m_cinfo.output_scanline;
+        jpeg_read_raw_data(&m_cinfo, componentRows, imcuRows);
+        unsigned int lastRow = std::min(firstRow + imcuRows, m_height);
+
+        for (unsigned int y = firstRow; y < lastRow; y++) {
+            std::memcpy(planes[0] + y * m_width, componentRows[0][y - firstRow],
+                        m_width);
+        }
+
+        /* Chroma is sampled at every other luma pixel. With the usual 2x2
+         * subsampling, that's every chroma sample.
+         */
+        for (int c = 1; c < 3; c++) {
+            auto& comp = m_cinfo.comp_info[c];
+            unsigned int h = comp.h_samp_factor;
+            unsigned int v = comp.v_samp_factor;
+
+            // iMCU rows have an even number of rows, so firstRow is even
+            for (unsigned int y = firstRow; y < lastRow; y += 2) {
+                const uint8_t* src =
+                    componentRows[c][(y - firstRow) * v / maxV];
+                uint8_t* dst = planes[c] + y / 2 * chromaWidth;
+                if (2 * h == maxH) {
+                    std::memcpy(dst, src, chromaWidth);
+                } else {
+                    for (unsigned int x = 0; x < chromaWidth; x++) {
+                        dst[x] = src[2 * x * h / maxH];
+                    }
+                }
+            }
+        }
+
+        if (sink != nullptr) {
+            sink->processRows(planes[0] + firstRow * m_width, firstRow,
+                              lastRow - firstRow, m_width);
+        }
+    }
+
+    if (sink != nullptr) {
+        sink->endImage();
+    }
+
+    jpeg_finish_decompress(&m_cinfo);
+}
+
+void JpegDecoder::decodeWindow(std::vector<uint8_t>& image) {
+    jpeg_start_decompress(&m_cinfo);
+
+    m_width = m_cinfo.output_width;
+    m_height = m_cinfo.output_height;
+    m_channels = m_cinfo.output_components;
+    unsigned int stride = m_width * m_channels;
+
+    // jpeg_crop_scanline() widens the columns to whole iMCUs
+    JDIMENSION x = std::min(m_windowX, m_width - 1);
+    JDIMENSION width = std::min(m_windowWidth, m_width - x);
+    jpeg_crop_scanline(&m_cinfo, &x, &width);
+
+    unsigned int imcuRows = m_cinfo.max_v_samp_factor * DCTSIZE;
+    unsigned int firstRow = std::min(m_windowY, m_height) / imcuRows * imcuRows;
+    unsigned int lastRow = std::min(m_windowY + m_windowHeight, m_height);
+
+    // Skipped rows are entropy decoded, but not transformed or converted
+    jpeg_skip_scanlines(&m_cinfo, firstRow);
+
+    while (m_cinfo.output_scanline < lastRow) {
+        unsigned int batchRow = m_cinfo.output_scanline;
+        unsigned int numRows = std::min(k_batchRows, lastRow - batchRow);
+
+        // Cropped rows are written where their columns are in the image
+        for (unsigned int i = 0; i < numRows; i++) {
+            m_rows[i] = &image[(batchRow + i) * stride + x * m_channels];
+        }
+        jpeg_read_scanlines(&m_cinfo, m_rows, numRows);
+    }
+
+    // Rows after the window are never read, so the decode is abandoned
+    jpeg_abort_decompress(&m_cinfo);
+    m_complete = false;
+
+    Metrics::add(Metrics::Counter::rowsSkipped,
+                 m_height - (lastRow - firstRow));
+}
+
+void JpegDecoder::decodeCandidates(uint8_t* data, size_t size,
+                                   std::vector<uint8_t>& image,
+                                   ScanlineSink* sink) {
+    unsigned int maxV = m_cinfo.max_v_samp_factor;
+    unsigned int imcuRows = maxV * DCTSIZE;
+    readThumbnail();
+
+    m_candidateRows.assign(m_thumbnailHeight, false);
+    m_candidateFinder->findCandidates(m_thumbnail.data(), m_thumbnailWidth,
+                                      m_thumbnailHeight, 3, m_candidateRows);
+
+    m_channels = 3;
+    if (image.size() != m_width * m_height * m_channels) {
+        image.resize(m_width * m_height * m_channels);
+    }
+
+    if (sink != nullptr) {
+        sink->beginImage(m_width, m_height, m_channels);
+    }
+
+    /* The image is decoded again, skipping to each band of iMCU rows which
+     * contains a candidate. Frames without candidates are never decompressed.
+     */
+    unsigned int numImcuRows = (m_thumbnailHeight + maxV - 1) / maxV;
+    auto hasCandidate = [&](unsigned int imcuRow) {
+        unsigned int end = std::min((imcuRow + 1) * maxV, m_thumbnailHeight);
+        for (unsigned int i = imcuRow * maxV; i < end; i++) {
+            if (m_candidateRows[i]) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    bool started = false;
+    unsigned int skipped = 0;
+    unsigned int imcuRow = 0;
+    while (imcuRow < numImcuRows) {
+        unsigned int first = imcuRow;
+        while (first < numImcuRows && !hasCandidate(first)) {
+            first++;
+        }
+        unsigned int last = first;
+        while (last < numImcuRows && hasCandidate(last)) {
+            last++;
+        }
+
+        unsigned int row = imcuRow * imcuRows;
+        unsigned int bandStart = std::min(first * imcuRows, m_height);
+        unsigned int bandEnd = std::min(last * imcuRows, m_height);
+        imcuRow = last;
+
+        fillRows(image.data(), row, bandStart, sink);
+        skipped += bandStart - row;
+        if (bandStart == bandEnd) {
+            continue;
+        }
+
+        if (!started) {
+            jpeg_mem_src(&m_cinfo, data, size);
+            jpeg_read_header(&m_cinfo, TRUE);
+            m_cinfo.do_fancy_upsampling = FALSE;
+            m_cinfo.do_block_smoothing = FALSE;
+            jpeg_start_decompress(&m_cinfo);
+            started = true;
+        }
+
+        // Skipped rows are entropy decoded, but not transformed or converted
+        jpeg_skip_scanlines(&m_cinfo, bandStart - m_cinfo.output_scanline);
+
+        unsigned int stride = m_width * m_channels;
+        while (m_cinfo.output_scanline < bandEnd) {
+            unsigned int firstRow = m_cinfo.output_scanline;
+            unsigned int numRows = std::min(k_batchRows, bandEnd - firstRow);
+
+            uint8_t* batch = image.data() + firstRow * stride;
+            for (unsigned int i = 0; i < numRows; i++) {
+                m_rows[i] = batch + i * stride;
+            }
+
+            // The decoder may return fewer rows than requested
+            numRows = jpeg_read_scanlines(&m_cinfo, m_rows, numRows);
+
+            if (sink != nullptr) {
+                sink->processRows(batch, firstRow, numRows, stride);
+            }
+        }
+    }
+
+    if (sink != nullptr) {
+        sink->endImage();
+    }
+
+    // Rows after the last band are never read, so the decode is abandoned
+    if (started) {
+        jpeg_abort_decompress(&m_cinfo);
+    }
+
+    Metrics::add(Metrics::Counter::rowsSkipped, skipped);
+    m_complete = skipped == 0;
+
+    /* The rows before each band are entropy decoded twice, so decoding
+     * candidates costs more than decoding the whole frame. A target is
+     * likely to still be there in the next frames, so those are decoded
+     * normally.
+     */
+    if (started) {
+        m_fullDecodesLeft = k_fullDecodeFrames;
+    }
+}
+
+void JpegDecoder::readThumbnail() {
+    m_width = m_cinfo.image_width;
+    m_height = m_cinfo.image_height;
+
+    /* Scaling by 1/8 makes each block's IDCT just its DC coefficient, without
+     * buffering the coefficients of the whole image like
+     * jpeg_read_coefficients() does
+     */
+    m_cinfo.scale_num = 1;
+    m_cinfo.scale_denom = DCTSIZE;
+    jpeg_start_decompress(&m_cinfo);
+
+    m_thumbnailWidth = m_cinfo.output_width;
+    m_thumbnailHeight = m_cinfo.output_height;
+    unsigned int stride = m_thumbnailWidth * m_cinfo.output_components;
+    m_thumbnail.resize(stride * m_thumbnailHeight);
+
+    while (m_cinfo.output_scanline < m_cinfo.output_height) {
+        JSAMPROW row = &m_thumbnail[m_cinfo.output_scanline * stride];
+        jpeg_read_scanlines(&m_cinfo, &row, 1);
+    }
+
+    jpeg_finish_decompress(&m_cinfo);
+}
+
+void JpegDecoder::fillRows(uint8_t* image, unsigned int firstRow,
+                           unsigned int lastRow, ScanlineSink* sink) {
+    unsigned int stride = m_width * 3;
+    for (unsigned int y = firstRow; y < lastRow; y++) {
+        uint8_t* row = image + y * stride;
+        if (y % DCTSIZE != 0 && y != firstRow) {
+            // Every row of a block gets the same colors
+            std::memcpy(row, row - stride, stride);
+        } else {
+            const uint8_t* colors =
+                &m_thumbnail[y / DCTSIZE * m_thumbnailWidth * 3];
+            for (unsigned int x = 0; x < m_width; x++) {
+                std::memcpy(row + 3 * x, colors + x / DCTSIZE * 3, 3);
+            }
+        }
+    }
+
+    if (sink != nullptr) {
+        for (unsigned int y = firstRow; y < lastRow; y += k_batchRows) {
+            sink->processRows(image + y * stride, y,
+                              std::min(k_batchRows, lastRow - y), stride);
+        }
+    }
+}
+
+void JpegDecoder::setGrayscale(bool grayscale) { m_grayscale = grayscale; }
+
+void JpegDecoder::setChromaPlanes(bool chromaPlanes) {
+    m_chromaPlanes = chromaPlanes;
+}
+
+void JpegDecoder::setCandidateFinder(CandidateFinder* finder) {
+    m_candidateFinder = finder;
+}
+
+void JpegDecoder::setWindow(unsigned int x, unsigned int y, unsigned int width,
+                            unsigned int height) {
+    m_windowX = x;
+    m_windowY = y;
+    m_windowWidth = width;
+    m_windowHeight = height;
+}
+
+unsigned int JpegDecoder::getWidth() const { return m_width; }
+
+unsigned int JpegDecoder::getHeight() const { return m_height; }
+
+unsigned int JpegDecoder::getChannels() const { return m_channels; }
+
+bool JpegDecoder::isComplete() const { return m_complete; }
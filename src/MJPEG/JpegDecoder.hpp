@@ -0,0 +1,146 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+#include <jpeglib.h>
+
+#include "CandidateFinder.hpp"
+#include "ScanlineSink.hpp"
+
+/**
+ * Decompresses JPEGs from memory into RGB or grayscale images
+ *
+ * Rows are decoded several at a time. If a ScanlineSink is given, it receives
+ * each batch while the rows are still in cache. If a CandidateFinder is set,
+ * only the rows it picks from a thumbnail of each image are decoded. If a
+ * window is set, only the part of the image in it is decoded.
+ */
+class JpegDecoder {
+public:
+    JpegDecoder();
+    virtual ~JpegDecoder();
+
+    JpegDecoder(const JpegDecoder&) = delete;
+    JpegDecoder& operator=(const JpegDecoder&) = delete;
+
+    /* Decompresses 'size' bytes of JPEG data into 'image', resizing it if
+     * necessary. If 'sink' isn't nullptr, it's given every row as it's
+     * decoded. Returns false if the data isn't a JPEG.
+     */
+    bool decode(uint8_t* data, size_t size, std::vector<uint8_t>& image,
+                ScanlineSink* sink = nullptr);
+
+    /* If true, images are decoded to grayscale. Only the luma of color JPEGs
+     * is decompressed, which skips their chroma IDCTs, upsampling and color
+     * conversion.
+     */
+    void setGrayscale(bool grayscale);
+
+    /* If true along with setGrayscale(), the luma plane of each image is
+     * followed by its Cb and Cr planes, each subsampled by 2 in both
+     * directions with their sizes rounded up (the I420 layout). Color JPEGs
+     * are then decoded with raw data output, which skips upsampling and color
+     * conversion; grayscale JPEGs get neutral chroma. The sink only sees the
+     * luma rows.
+     */
+    void setChromaPlanes(bool chromaPlanes);
+
+    /* If 'finder' isn't nullptr, color images are first decoded to a
+     * thumbnail of their DC coefficients, and only the iMCU rows containing
+     * rows of blocks the finder picks are decompressed. The rest of the image
+     * is filled with the thumbnail's colors, so each 8x8 block there has its
+     * average color. After a frame with candidates, the next
+     * k_fullDecodeFrames frames are decoded in full, as are frames the finder
+     * doesn't want a thumbnail of. This doesn't apply to grayscale output.
+     */
+    void setCandidateFinder(CandidateFinder* finder);
+
+    /* Limits decoding to the window of 'width' x 'height' pixels at ('x',
+     * 'y'), widened to whole iMCUs. Only those rows are decompressed, and
+     * jpeg_crop_scanline() skips the IDCTs of the columns outside it. The
+     * rest of the output image keeps the pixels it had, so the whole image is
+     * decoded if the output image isn't already the right size. A width or
+     * height of 0 decodes whole images. The sink isn't given windowed images.
+     * This doesn't apply with chroma planes.
+     */
+    void setWindow(unsigned int x, unsigned int y, unsigned int width,
+                   unsigned int height);
+
+    // Return the dimensions of the last image decoded
+    unsigned int getWidth() const;
+    unsigned int getHeight() const;
+    unsigned int getChannels() const;
+
+    /* Returns false if part of the last image decoded was left as it was or
+     * filled from the thumbnail
+     */
+    bool isComplete() const;
+
+private:
+    // Most rows jpeg_read_scanlines() is asked for at once
+    static constexpr unsigned int k_batchRows = 16;
+
+    // Frames decoded in full after one with candidates (0.5 s at 30 FPS)
+    static constexpr unsigned int k_fullDecodeFrames = 15;
+
+    struct jpeg_decompress_struct m_cinfo;
+    struct jpeg_error_mgr m_jerr;
+
+    JSAMPROW m_rows[k_batchRows];
+
+    bool m_grayscale = false;
+    bool m_chromaPlanes = false;
+
+    // Rows of one iMCU row of each component for raw data output
+    std::vector<uint8_t> m_rawBuf;
+    std::vector<JSAMPROW> m_rawRows;
+
+    CandidateFinder* m_candidateFinder = nullptr;
+
+    // Average color of each block of the image being decoded
+    std::vector<uint8_t> m_thumbnail;
+    unsigned int m_thumbnailWidth = 0;
+    unsigned int m_thumbnailHeight = 0;
+
+    std::vector<bool> m_candidateRows;
+    unsigned int m_fullDecodesLeft = 0;
+
+    unsigned int m_windowX = 0;
+    unsigned int m_windowY = 0;
+    unsigned int m_windowWidth = 0;
+    unsigned int m_windowHeight = 0;
+
+    unsigned int m_width = 0;
+    unsigned int m_height = 0;
+    unsigned int m_channels = 0;
+    bool m_complete = true;
+
+    /* Decodes the Y, Cb, and Cr components of the JPEG whose header was just
+     * read into 'image' in the layout described by setChromaPlanes()
+     */
+    void decodeRaw(std::vector<uint8_t>& image, ScanlineSink* sink);
+
+    /* Decodes the window of the JPEG whose header was just read into 'image',
+     * which is already the size of the whole image
+     */
+    void decodeWindow(std::vector<uint8_t>& image);
+
+    /* Decodes the JPEG whose header was just read into 'image', decompressing
+     * only the iMCU rows containing rows of blocks the candidate finder picks
+     */
+    void decodeCandidates(uint8_t* data, size_t size,
+                          std::vector<uint8_t>& image, ScanlineSink* sink);
+
+    // Decodes the JPEG whose header was just read into m_thumbnail
+    void readThumbnail();
+
+    // Fills rows ['firstRow', 'lastRow') of 'image' from the thumbnail
+    void fillRows(uint8_t* image, unsigned int firstRow, unsigned int lastRow,
+                  ScanlineSink* sink);
+};
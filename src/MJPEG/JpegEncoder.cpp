@@ -0,0 +1,194 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#include "JpegEncoder.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+JpegEncoder::JpegEncoder(unsigned int numThreads) {
+    m_pool = std::make_unique<ThreadPool>(numThreads);
+
+    for (unsigned int i = 0; i < m_pool->size(); i++) {
+        auto strip = std::make_unique<Strip>();
+
+        // Set up the error handler
+        strip->cinfo.err = jpeg_std_error(&strip->jerr);
+
+        // Initialize the JPEG compression object
+        jpeg_create_compress(&strip->cinfo);
+
+        m_strips.emplace_back(std::move(strip));
+    }
+}
+
+JpegEncoder::~JpegEncoder() {
+    for (auto& strip : m_strips) {
+        jpeg_destroy_compress(&strip->cinfo);
+        std::free(strip->buf);
+    }
+}
+
+void JpegEncoder::setQuality(int quality) {
+    m_quality = std::max(1, std::min(quality, 100));
+}
+
+int JpegEncoder::getQuality() const { return m_quality; }
+
+bool JpegEncoder::encode(const uint8_t* image, unsigned int width,
+                         unsigned int height, unsigned int channels,
+                         std::vector<uint8_t>& out) {
+    if (width == 0 || height == 0 || (channels != 1 && channels != 3)) {
+        return false;
+    }
+
+    /* Grayscale images are encoded as one 8x8 block per MCU. Color images use
+     * jpeg_set_defaults()'s 2x2 luma subsampling, so an MCU is 16x16 pixels.
+     */
+    unsigned int mcuSize = channels == 3 ? 16 : 8;
+    unsigned int mcusPerRow = (width + mcuSize - 1) / mcuSize;
+    unsigned int mcuRows = (height + mcuSize - 1) / mcuSize;
+
+    unsigned int numStrips = std::min<unsigned int>(m_strips.size(), mcuRows);
+    unsigned int mcuRowsPerStrip = (mcuRows + numStrips - 1) / numStrips;
+
+    // DRI stores the restart interval in 16 bits
+    if (mcusPerRow * mcuRowsPerStrip > 65535) {
+        numStrips = 1;
+    }
+
+    if (numStrips <= 1) {
+        Strip& strip = *m_strips[0];
+        compress(strip, image, width, height, channels, 0);
+        out.assign(strip.buf, strip.buf + strip.len);
+        return true;
+    }
+
+    // Recompute the strip count so no strip is empty
+    unsigned int rowsPerStrip = mcuRowsPerStrip * mcuSize;
+    numStrips = (height + rowsPerStrip - 1) / rowsPerStrip;
+    unsigned int restartInterval = mcusPerRow * mcuRowsPerStrip;
+
+    m_pool->parallelFor(numStrips, [&](unsigned int i) {
+        unsigned int firstRow = i * rowsPerStrip;
+        unsigned int rows = std::min(rowsPerStrip, height - firstRow);
+        compress(*m_strips[i], image + firstRow * width * channels, width,
+                 rows, channels, restartInterval);
+    });
+
+    /* ===== Join strips into one JPEG ===== */
+    /* The first strip supplies the headers (with the SOF height patched to
+     * the full image height). Each strip contributes its entropy-coded
+     * segment without the trailing EOI marker, and consecutive segments are
+     * separated by RST0 through RST7 in rotation.
+     */
+    Strip& first = *m_strips[0];
+    size_t headerLen = findScanData(first.buf, first.len, height);
+    if (headerLen == 0) {
+        return false;
+    }
+
+    out.assign(first.buf, first.buf + headerLen);
+    for (unsigned int i = 0; i < numStrips; i++) {
+        Strip& strip = *m_strips[i];
+        size_t dataStart =
+            i == 0 ? headerLen : findScanData(strip.buf, strip.len, 0);
+
+        // Every strip must end with an EOI marker
+        if (dataStart == 0 || strip.len < dataStart + 2 ||
+            strip.buf[strip.len - 2] != 0xFF ||
+            strip.buf[strip.len - 1] != JPEG_EOI) {
+            return false;
+        }
+
+        if (i > 0) {
+            out.push_back(0xFF);
+            out.push_back(JPEG_RST0 + (i - 1) % 8);
+        }
+        out.insert(out.end(), strip.buf + dataStart, strip.buf + strip.len - 2);
+    }
+    out.push_back(0xFF);
+    out.push_back(JPEG_EOI);
+    /* ===================================== */
+
+    return true;
+}
+
+void JpegEncoder::compress(Strip& strip, const uint8_t* image,
+                           unsigned int width, unsigned int rows,
+                           unsigned int channels,
+                           unsigned int restartInterval) {
+    jpeg_compress_struct& cinfo = strip.cinfo;
+
+    /* First we supply a description of the input image. Four fields of the
+     * cinfo struct must be filled in:
+     */
+    cinfo.image_width = width;          // image width, in pixels
+    cinfo.image_height = rows;          // image height, in pixels
+    cinfo.input_components = channels;  // # of color components per pixel
+    cinfo.in_color_space =
+        channels == 3 ? JCS_EXT_BGR : JCS_GRAYSCALE;  // colorspace of input
+
+    // Use the library's routine to set default compression parameters
+    jpeg_set_defaults(&cinfo);
+
+    // Set any non-default parameters
+    jpeg_set_quality(&cinfo, m_quality, TRUE /* limit to baseline-JPEG */);
+    cinfo.restart_interval = restartInterval;
+
+    /* Specify data destination. The strip's buffer is reused if it's large
+     * enough; otherwise, libjpeg allocates a larger one which replaces it.
+     */
+    uint8_t* buf = strip.buf;
+    unsigned long int len = strip.capacity;  // NOLINT
+    jpeg_mem_dest(&cinfo, &buf, &len);
+
+    // TRUE ensures that we will write a complete interchange-JPEG file
+    jpeg_start_compress(&cinfo, TRUE);
+
+    JSAMPROW rowPointer;
+    while (cinfo.next_scanline < cinfo.image_height) {
+        rowPointer = const_cast<JSAMPROW>(
+            image + cinfo.next_scanline * width * channels);
+        (void)jpeg_write_scanlines(&cinfo, &rowPointer, 1);
+    }
+
+    jpeg_finish_compress(&cinfo);
+
+    if (buf != strip.buf) {
+        std::free(strip.buf);
+        strip.buf = buf;
+        strip.capacity = len;
+    }
+    strip.len = len;
+}
+
+size_t JpegEncoder::findScanData(uint8_t* buf, size_t len,
+                                 unsigned int height) {
+    if (len < 4 || buf[0] != 0xFF || buf[1] != 0xD8) {
+        return 0;
+    }
+
+    // Walk the marker segments until the start of scan
+    size_t pos = 2;
+    while (pos + 4 <= len) {
+        if (buf[pos] != 0xFF) {
+            return 0;
+        }
+
+        uint8_t marker = buf[pos + 1];
+        size_t segmentLen = (buf[pos + 2] << 8) | buf[pos + 3];
+
+        // SOF0 stores precision, then height as a big-endian 16-bit value
+        if (marker == 0xC0 && height != 0 && pos + 7 <= len) {
+            buf[pos + 5] = height >> 8;
+            buf[pos + 6] = height & 0xFF;
+        }
+
+        pos += 2 + segmentLen;
+        if (marker == 0xDA) {
+            return pos <= len ? pos : 0;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,66 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include <jpeglib.h>
+
+#include "../ThreadPool.hpp"
+
+/**
+ * Compresses BGR or grayscale images into baseline JPEGs
+ *
+ * When more than one thread is used, the image is split into horizontal strips
+ * aligned to MCU rows. The strips are compressed in parallel with a restart
+ * interval of one strip, then joined with RSTn markers into a single JPEG.
+ */
+class JpegEncoder {
+public:
+    // A thread count of 0 uses one thread per hardware core
+    explicit JpegEncoder(unsigned int numThreads = 1);
+    virtual ~JpegEncoder();
+
+    JpegEncoder(const JpegEncoder&) = delete;
+    JpegEncoder& operator=(const JpegEncoder&) = delete;
+
+    // Sets JPEG quality from 1 to 100 inclusive
+    void setQuality(int quality);
+    int getQuality() const;
+
+    /* Compresses the image into 'out'. 'channels' is 3 for a BGR image or 1
+     * for a grayscale image. Returns false if the image couldn't be encoded.
+     */
+    bool encode(const uint8_t* image, unsigned int width, unsigned int height,
+                unsigned int channels, std::vector<uint8_t>& out);
+
+private:
+    struct Strip {
+        struct jpeg_compress_struct cinfo;
+        struct jpeg_error_mgr jerr;
+
+        // Buffer is owned by the strip and reused between frames
+        uint8_t* buf = nullptr;
+        unsigned long int capacity = 0;  // NOLINT
+        unsigned long int len = 0;       // NOLINT
+    };
+
+    std::vector<std::unique_ptr<Strip>> m_strips;
+    std::unique_ptr<ThreadPool> m_pool;
+    int m_quality = 100;
+
+    // Compresses 'rows' rows starting at 'image' into the given strip
+    void compress(Strip& strip, const uint8_t* image, unsigned int width,
+                  unsigned int rows, unsigned int channels,
+                  unsigned int restartInterval);
+
+    /* Returns the offset of the first byte of entropy-coded data after the SOS
+     * segment, or 0 if the buffer isn't a well-formed JPEG. If 'height' isn't
+     * zero, the height in the SOF segment is overwritten with it.
+     */
+    static size_t findScanData(uint8_t* buf, size_t len, unsigned int height);
+};
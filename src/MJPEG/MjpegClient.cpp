@@ -2,6 +2,7 @@
 
 #include "MjpegClient.hpp"
 
+#include <chrono>
 #include <cstring>
 #include <iostream>
 #include <map>
@@ -10,6 +11,8 @@
 
 #include <QImage>
 
+#include "../Metrics.hpp"
+
 MjpegClient::MjpegClient(const std::string& hostName, unsigned short port,
                          const std::string& requestPath)
     : m_hostName(hostName), m_port(port), m_requestPath(requestPath) {
@@ -23,19 +26,11 @@ MjpegClient::MjpegClient(const std::string& hostName, unsigned short port,
     }
     m_cancelfdr = pipefd[0];
     m_cancelfdw = pipefd[1];
-
-    m_cinfo.err = jpeg_std_error(&m_jerr);
-    m_cinfo.do_fancy_upsampling = 0;
-    m_cinfo.do_block_smoothing = 0;
-
-    jpeg_create_decompress(&m_cinfo);
 }
 
 MjpegClient::~MjpegClient() {
     stop();
 
-    jpeg_destroy_decompress(&m_cinfo);
-
     mjpeg_sck_close(m_cancelfdr);
     mjpeg_sck_close(m_cancelfdw);
 }
@@ -73,7 +68,9 @@ bool MjpegClient::isStreaming() const { return !m_stopReceive; }
 void MjpegClient::saveCurrentImage(const std::string& fileName) {
     std::lock_guard<std::mutex> lock(m_imageMutex);
 
-    QImage tmp(&m_pxlBuf[0], m_imgWidth, m_imgHeight, QImage::Format_RGB888);
+    QImage tmp(&m_pxlBuf[0], m_imgWidth, m_imgHeight,
+               m_imgChannels == 1 ? QImage::Format_Grayscale8
+                                  : QImage::Format_RGB888);
     if (!tmp.save(fileName.c_str())) {
         std::cout << "MjpegClient: failed to save image to '" << fileName
                   << "'\n";
@@ -90,6 +87,7 @@ uint8_t* MjpegClient::getCurrentImage() {
         m_extHeight = m_imgHeight;
     }
 
+    m_extChannels = m_imgChannels;
     m_extBuf = m_pxlBuf;
 
     return &m_extBuf[0];
@@ -105,46 +103,9 @@ unsigned int MjpegClient::getCurrentHeight() const {
     return m_extHeight;
 }
 
-bool MjpegClient::jpeg_load_from_memory(uint8_t* inputBuf, int inputLen,
-                                        std::vector<uint8_t>& outputBuf) {
-    // JPEG images start with bytes 0xFF, 0xD8 and end with bytes 0xFF, 0xD9.
-    // Don't process data that isn't JPEG.
-    if (inputBuf[0] != 0xFF || inputBuf[1] != 0xD8) {
-        std::cout << "jpeg_load_from_memory: invalid magic: " << std::hex
-                  << "0x" << static_cast<uint32_t>(inputBuf[0]) << ", "
-                  << "0x" << static_cast<uint32_t>(inputBuf[1]) << std::dec
-                  << std::endl;
-        return false;
-    }
-
-    jpeg_mem_src(&m_cinfo, inputBuf, inputLen);
-    if (jpeg_read_header(&m_cinfo, TRUE) != JPEG_HEADER_OK) {
-        return false;
-    }
-
-    jpeg_start_decompress(&m_cinfo);
-
-    int m_row_stride = m_cinfo.output_width * m_cinfo.output_components;
-
-    m_imgWidth = m_cinfo.output_width;
-    m_imgHeight = m_cinfo.output_height;
-    m_imgChannels = m_cinfo.output_components;
-
-    // Change size of output buffer if necessary
-    if (outputBuf.size() != m_imgWidth * m_imgChannels * m_imgHeight) {
-        outputBuf.resize(m_imgWidth * m_imgChannels * m_imgHeight);
-    }
-
-    uint8_t* sampleBuf;
-    for (int outpos = 0; m_cinfo.output_scanline < m_cinfo.output_height;
-         outpos += m_row_stride) {
-        sampleBuf = &outputBuf[outpos];
-        jpeg_read_scanlines(&m_cinfo, &sampleBuf, 1);
-    }
-
-    jpeg_finish_decompress(&m_cinfo);
-
-    return true;
+unsigned int MjpegClient::getCurrentChannels() const {
+    std::lock_guard<std::mutex> lock(m_extMutex);
+    return m_extChannels;
 }
 
 void MjpegClient::recvFunc() {
@@ -199,8 +160,17 @@ void MjpegClient::recvFunc() {
             std::cerr << "mjpegrx: recv(2) failed\n";
             break;
         }
+        m_receiveTime = std::chrono::steady_clock::now();
+        Metrics::add(Metrics::Counter::framesReceived);
+
+        // A repeated JPEG would decode to the image already in m_pxlBuf
+        if (ClientBase::isDuplicate(&buf[0], datasize)) {
+            ClientBase::callRepeatedImage();
+            continue;
+        }
 
         // Load the image received (converts from JPEG to pixel array)
+        auto startTime = std::chrono::steady_clock::now();
         bool decompressed = false;
         {
             std::lock_guard<std::mutex> lock(m_imageMutex);
@@ -208,7 +178,12 @@ void MjpegClient::recvFunc() {
         }
 
         if (decompressed) {
+            Metrics::addLatency(Metrics::Stage::decode,
+                                std::chrono::steady_clock::now() - startTime);
+            Metrics::add(Metrics::Counter::framesDecoded);
             ClientBase::callNewImage(&m_pxlBuf[0], m_pxlBuf.size());
+        } else {
+            Metrics::drop(Metrics::DropReason::decodeFailed);
         }
     }
 
@@ -12,8 +12,6 @@
 #include <utility>
 #include <vector>
 
-#include <jpeglib.h>
-
 #include "ClientBase.hpp"
 #include "mjpeg_sck.hpp"
 
@@ -46,9 +44,10 @@ public:
      */
     uint8_t* getCurrentImage();
 
-    // Returns size of image currently in secondary buffer
+    // Returns size and channels of image currently in secondary buffer
     unsigned int getCurrentWidth() const;
     unsigned int getCurrentHeight() const;
+    unsigned int getCurrentChannels() const;
 
 private:
     std::string m_hostName;
@@ -57,9 +56,6 @@ private:
 
     // Stores image before displaying it on the screen
     std::vector<uint8_t> m_pxlBuf;
-    unsigned int m_imgWidth = 0;
-    unsigned int m_imgHeight = 0;
-    unsigned int m_imgChannels = 0;
     mutable std::mutex m_imageMutex;
 
     /* Stores copy of image for use by external programs. It only updates when
@@ -68,6 +64,7 @@ private:
     std::vector<uint8_t> m_extBuf;
     unsigned int m_extWidth = 0;
     unsigned int m_extHeight = 0;
+    unsigned int m_extChannels = 0;
     mutable std::mutex m_extMutex;
 
     std::thread m_recvThread;
@@ -83,24 +80,8 @@ private:
     mjpeg_socket_t m_cancelfdw = 0;
     mjpeg_socket_t m_sd = INVALID_SOCKET;
 
-    struct jpeg_decompress_struct m_cinfo;
-    struct jpeg_error_mgr m_jerr;
-    JSAMPARRAY m_buffer = nullptr; /* Output row buffer */
-
     // Used by m_recvThread
     void recvFunc();
-
-    /**
-     * Decompresses JPEG data from memory into another buffer. width, height,
-     * and channel amount are stored in member variables.
-     *
-     * @param inputBuf input JPEG data
-     * @param inputLen length of input buffer
-     * @param outputBuf output buffer for decompressed image
-     * @return true if decompressed successfully or false otherwise
-     */
-    bool jpeg_load_from_memory(uint8_t* inputBuf, int inputLen,
-                               std::vector<uint8_t>& outputBuf);
 };
 
 int mjpeg_rxheaders(std::vector<uint8_t>& buf, int sd, int cancelfd);
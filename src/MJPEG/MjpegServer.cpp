@@ -2,13 +2,26 @@
 
 #include "MjpegServer.hpp"
 
+#include <algorithm>
+#include <cctype>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <sstream>
 #include <system_error>
 
-MjpegServer::MjpegServer(uint16_t port) : m_port(port) {
+#include "../Metrics.hpp"
+#include "FrameRecord.hpp"
+#include "MulticastPacket.hpp"
+
+constexpr int MjpegServer::k_maxQuality;
+constexpr size_t MjpegServer::k_maxRequestSize;
+constexpr std::chrono::seconds MjpegServer::k_repeatInterval;
+constexpr std::chrono::seconds MjpegServer::k_snapshotTimeout;
+constexpr size_t MjpegServer::k_zeroCopyThreshold;
+
+MjpegServer::MjpegServer(uint16_t port, unsigned int encodeThreads)
+    : m_port(port), m_encoder(encodeThreads) {
     mjpeg_socket_t pipefd[2];
 
     /* Create a pipe that, when written to, causes any operation in the
@@ -19,94 +32,22 @@ MjpegServer::MjpegServer(uint16_t port) : m_port(port) {
     }
     m_cancelfdr = pipefd[0];
     m_cancelfdw = pipefd[1];
-
-    // Set up the error handler
-    m_cinfo.err = jpeg_std_error(&m_jerr);
-
-    // Initialize the JPEG compression object
-    jpeg_create_compress(&m_cinfo);
-
-    /* First we supply a description of the input image. Four fields of the
-     * cinfo struct must be filled in:
-     */
-    m_cinfo.image_width = 320;             // image width, in pixels
-    m_cinfo.image_height = 240;            // image height, in pixels
-    m_cinfo.input_components = 3;          // # of color components per pixel
-    m_cinfo.in_color_space = JCS_EXT_BGR;  // colorspace of input image
-
-    // Use the library's routine to set default compression parameters
-    jpeg_set_defaults(&m_cinfo);
-
-    // Set any non-default parameters
-    jpeg_set_quality(&m_cinfo, 100, TRUE /* limit to baseline-JPEG values */);
-
-    m_row_pointer = nullptr;
 }
 
 MjpegServer::~MjpegServer() {
     stop();
 
-    jpeg_destroy_compress(&m_cinfo);
-
     mjpeg_sck_close(m_cancelfdr);
     mjpeg_sck_close(m_cancelfdw);
-    std::free(m_serveImg);
 }
 
 void MjpegServer::start() {
     if (!m_isRunning) {
-        m_listenSock = socket(AF_INET, SOCK_STREAM, 0);
-
-        if (mjpeg_sck_valid(m_listenSock)) {
-            mjpeg_sck_setnonblocking(m_listenSock, 0);
-
-            /* Disable the Nagle algorithm (ie. removes buffering of TCP
-             * packets)
-             */
-            int yes = 1;
-            if (setsockopt(m_listenSock, IPPROTO_TCP, TCP_NODELAY,
-                           reinterpret_cast<char*>(&yes), sizeof(yes)) == -1) {
-                mjpeg_sck_close(m_listenSock);
-                std::cout << "MjpegServer: failed to remove TCP buffering\n";
-                return;  // Failed to remove buffering
-            }
-
-            // Allow reconnecting to the same port after server restart
-            if (setsockopt(m_listenSock, SOL_SOCKET, SO_REUSEADDR,
-                           reinterpret_cast<char*>(&yes), sizeof(yes)) == -1) {
-                mjpeg_sck_close(m_listenSock);
-                std::cout << "MjpegServer: failed to remove TCP buffering\n";
-                return;  // Failed to remove buffering
-            }
-        } else {
-            std::cout << "MjpegServer: failed to create listener socket\n";
-            return;  // Failed to create socket
-        }
-
-        // Bind the socket to the specified port
-        sockaddr_in address;
-        std::memset(&address, 0, sizeof(address));
-        address.sin_addr.s_addr = htonl(INADDR_ANY);
-        address.sin_family = AF_INET;
-        address.sin_port = htons(m_port);
-
-        if (bind(m_listenSock, reinterpret_cast<sockaddr*>(&address),
-                 sizeof(address)) == -1) {
-            mjpeg_sck_close(m_listenSock);
-            std::cout << "MjpegServer: failed to bind socket to port\n";
-            return;  // Failed to bind socket to port
+        m_listenSock = openListener(m_port);
+        if (!mjpeg_sck_valid(m_listenSock)) {
+            return;
         }
 
-        // Listen to the bound port
-        if (listen(m_listenSock, 0) == -1) {
-            mjpeg_sck_close(m_listenSock);
-            std::cout << "MjpegServer: failed to listen to port " << m_port
-                      << "\n";
-            return;  // Failed to listen to port
-        }
-
-        std::cout << "Started listening on " << m_port << "\n";
-
         // Zero selector before populating it
         m_clientSelector.zero(mjpeg_sck_selector::read |
                               mjpeg_sck_selector::write |
@@ -121,6 +62,16 @@ void MjpegServer::start() {
             m_listenSock,
             mjpeg_sck_selector::read | mjpeg_sck_selector::except);
 
+        // The server still runs without the record stream if it fails
+        if (m_recordPort != 0) {
+            m_recordListenSock = openListener(m_recordPort);
+            if (mjpeg_sck_valid(m_recordListenSock)) {
+                m_clientSelector.addSocket(m_recordListenSock,
+                                           mjpeg_sck_selector::read |
+                                               mjpeg_sck_selector::except);
+            }
+        }
+
         m_isRunning = true;
         m_serverThread = std::thread(&MjpegServer::serverFunc, this);
     }
@@ -136,94 +87,358 @@ void MjpegServer::stop() {
         m_serverThread.join();
 
         mjpeg_sck_close(m_listenSock);
+        if (mjpeg_sck_valid(m_recordListenSock)) {
+            mjpeg_sck_close(m_recordListenSock);
+            m_recordListenSock = INVALID_SOCKET;
+        }
 
         // Close and disconnect client sockets
-        for (auto i : m_clientSockets) {
-            mjpeg_sck_close(i);
+        for (auto& client : m_clients) {
+            mjpeg_sck_close(client.socket);
         }
 
-        m_clientSockets.clear();
+        m_clients.clear();
+
+        m_lastFrames.clear();
+        m_streamStates.clear();
     }
 }
 
 void MjpegServer::serveImage(uint8_t* image, unsigned int width,
-                             unsigned int height) {
+                             unsigned int height, unsigned int channels) {
+    serveImage("annotated", image, width, height, channels);
+
+#ifdef INSIGHT_WITH_H264
+    if (m_h264 != nullptr && channels == 3 && hasSubscribers("h264")) {
+        serveH264(image, width, height);
+    }
+#endif
+}
+
+void MjpegServer::serveImage(const std::string& stream, const uint8_t* image,
+                             unsigned int width, unsigned int height,
+                             unsigned int channels) {
+    auto startTime = std::chrono::steady_clock::now();
+
+    auto state = m_streamStates.find(stream);
+    if (state == m_streamStates.end()) {
+        state = m_streamStates.emplace(stream, StreamState()).first;
+        state->second.changeDetector.setThreshold(m_changeThreshold);
+    }
+    StreamState& streamState = state->second;
+
+    // Track how often the stream produces frames for the rate controllers
+    if (streamState.serveTime != std::chrono::steady_clock::time_point() &&
+        startTime > streamState.serveTime) {
+        std::chrono::duration<double> interval =
+            startTime - streamState.serveTime;
+        double rate = 1.0 / interval.count();
+        streamState.frameRate = streamState.frameRate == 0.0
+                                    ? rate
+                                    : 0.9 * streamState.frameRate + 0.1 * rate;
+    }
+    streamState.serveTime = startTime;
+
     // Don't bother making the JPEG if there are no clients to which to send it
-    if (m_clientSockets.size() == 0) {
+    if (!hasSubscribers(stream)) {
         return;
     }
 
-    /* ===== Convert RGB image to JPEG ===== */
-    m_cinfo.image_width = width;
-    m_cinfo.image_height = height;
+    /* ===== Skip unchanged images ===== */
+    if (!streamState.changeDetector.isChanged(image, width, height,
+                                              channels)) {
+        Metrics::drop(Metrics::DropReason::unchanged);
+
+        /* Record and WebSocket clients are sent every image's targets, so
+         * they get the last frame again with this image's id and capture
+         * time. Other clients are only repeated the frame occasionally so
+         * they know we're alive.
+         */
+        bool keepAlive = startTime - streamState.sendTime >= k_repeatInterval;
+        if (!streamState.frames.empty()) {
+            /* Clients are repeated the frame at the quality their rate
+             * controllers choose now. The image is unchanged, so qualities
+             * which weren't encoded for it yet are encoded from it.
+             */
+            std::vector<int> qualities;
+            {
+                std::lock_guard<std::mutex> lock(m_clientSocketMutex);
+                qualities = getReadyQualities(stream, startTime, !keepAlive);
+            }
+
+            const Frame& lastFrame = *streamState.frames.begin()->second;
+            for (int quality : qualities) {
+                if (streamState.frames.count(quality) > 0) {
+                    continue;
+                }
+
+                auto frame = encodeFrame(image, width, height, channels,
+                                         quality);
+                if (frame == nullptr) {
+                    streamState.changeDetector.reset();
+                    return;
+                }
+                frame->id = lastFrame.id;
+                frame->captureTime = lastFrame.captureTime;
+                streamState.frames.emplace(quality, frame);
+            }
+
+            if (!qualities.empty()) {
+                std::lock_guard<std::mutex> lock(m_clientSocketMutex);
+                repeatFrame(stream, streamState.frames,
+                            streamState.nextFrameId++,
+                            getCaptureTime(startTime), keepAlive, startTime);
+            }
+            if (keepAlive) {
+                streamState.sendTime = startTime;
+            }
+        }
+
+        // The cached frame still matches the image, so it answers snapshots
+        std::lock_guard<std::mutex> lock(m_clientSocketMutex);
+        auto lastFrame = m_lastFrames.find(stream);
+        if (lastFrame != m_lastFrames.end()) {
+            answerSnapshots(stream, lastFrame->second);
+        }
+        return;
+    }
+    /* ================================= */
 
-    /* Specify data destination (e.g. memory buffer). A new buffer will be
-     * allocated internally and stored in m_serveImg.
+    /* ===== Choose qualities to encode ===== */
+    /* Only clients whose rate limits allow a frame now are considered. Clients
+     * at the same quality share one encoded frame.
      */
-    jpeg_mem_dest(&m_cinfo, &m_serveImg, &m_serveLen);
+    std::vector<int> qualities;
+    {
+        std::lock_guard<std::mutex> lock(m_clientSocketMutex);
+        qualities = getReadyQualities(stream, startTime);
+
+        // Clients waiting for a snapshot get one frame at the highest quality
+        if (isSnapshotRequested(stream) &&
+            std::find(qualities.begin(), qualities.end(), k_maxQuality) ==
+                qualities.end()) {
+            qualities.emplace_back(k_maxQuality);
+        }
+    }
+
+    if (qualities.empty()) {
+        Metrics::drop(Metrics::DropReason::rateLimited);
+
+        // The cached frame no longer matches the change detector's reference
+        streamState.changeDetector.reset();
+        return;
+    }
+    /* ====================================== */
+
+    /* ===== Convert image to JPEG ===== */
+    uint32_t frameId = streamState.nextFrameId++;
+    auto captureTime = getCaptureTime(startTime);
+
+    std::map<int, FramePtr> frames;
+    for (int quality : qualities) {
+        auto frame = encodeFrame(image, width, height, channels, quality);
+        if (frame == nullptr) {
+            // Compare the next image against the last one actually sent
+            streamState.changeDetector.reset();
+            return;
+        }
+        frame->id = frameId;
+        frame->captureTime = captureTime;
+
+        frames.emplace(quality, frame);
+    }
+
+    // Encodings of any other image no longer match the change detector
+    streamState.frames = frames;
+    /* ================================= */
+
+    std::lock_guard<std::mutex> lock(m_clientSocketMutex);
+
+    // New clients and snapshots get the highest quality encoded
+    m_lastFrames[stream] = frames.rbegin()->second;
+    answerSnapshots(stream, frames.rbegin()->second);
+
+    // Send JPEG to all clients subscribed to the stream
+    for (auto i = m_clients.begin(); i != m_clients.end();) {
+        if (i->stream != stream) {
+            i++;
+            continue;
+        }
+
+        auto frame = frames.find(i->rate.getQuality());
+        if (frame == frames.end() || !i->rate.isReady(startTime)) {
+            Metrics::drop(Metrics::DropReason::rateLimited);
+            i++;
+            continue;
+        }
+
+        if (!sendFrame(*i, frame->second)) {
+            Metrics::drop(Metrics::DropReason::sendFailed);
+            i = removeClient(i);
+            continue;
+        }
+
+        i->rate.adjustQuality(frame->second->data.size(),
+                              streamState.frameRate);
+        i++;
+    }
+
+    if (m_multicast != nullptr && stream == m_multicastStream) {
+        auto frame = frames.find(m_multicastRate.getQuality());
+        if (frame != frames.end() && m_multicastRate.isReady(startTime)) {
+            sendMulticast(frame->second, startTime);
+            m_multicastRate.adjustQuality(frame->second->data.size(),
+                                          streamState.frameRate);
+        } else {
+            Metrics::drop(Metrics::DropReason::rateLimited);
+        }
+    }
+
+    streamState.sendTime = startTime;
+}
+
+#ifdef INSIGHT_WITH_H264
+void MjpegServer::serveH264(const uint8_t* image, unsigned int width,
+                            unsigned int height) {
+    auto startTime = std::chrono::steady_clock::now();
 
-    // TRUE ensures that we will write a complete interchange-JPEG file
-    jpeg_start_compress(&m_cinfo, TRUE);
+    auto frame = std::make_shared<Frame>();
+    bool keyframe = false;
+    if (!m_h264->encode(image, width, height, frame->data, keyframe) ||
+        frame->data.empty()) {
+        return;
+    }
 
-    /* while scan lines remain to be written...
-     * Here we use the library's state variable cinfo.next_scanline as
-     * the loop counter, so that we don't have to keep track ourselves.
+    Metrics::addLatency(Metrics::Stage::h264Encode,
+                        std::chrono::steady_clock::now() - startTime);
+    Metrics::add(Metrics::Counter::h264FramesEncoded);
+    Metrics::add(Metrics::Counter::h264BytesEncoded, frame->data.size());
+
+    /* Every frame is sent to every client since later frames depend on
+     * earlier ones. The encoder's rate control limits the bitrate instead.
      */
-    while (m_cinfo.next_scanline < m_cinfo.image_height) {
-        m_row_pointer = image + m_cinfo.next_scanline * m_cinfo.image_width *
-                                    m_cinfo.input_components;
-        (void)jpeg_write_scanlines(&m_cinfo, &m_row_pointer, 1);
+    std::lock_guard<std::mutex> lock(m_clientSocketMutex);
+    for (auto i = m_clients.begin(); i != m_clients.end();) {
+        if (i->stream != "h264" || (i->waitingForKeyframe && !keyframe)) {
+            i++;
+            continue;
+        }
+
+        i->waitingForKeyframe = false;
+        if (!sendFrame(*i, frame)) {
+            Metrics::drop(Metrics::DropReason::sendFailed);
+            i = removeClient(i);
+            continue;
+        }
+
+        i++;
     }
+}
+#endif
 
-    jpeg_finish_compress(&m_cinfo);
-    /* ===================================== */
+void MjpegServer::setChangeThreshold(int threshold) {
+    m_changeThreshold = threshold;
+    for (auto& state : m_streamStates) {
+        state.second.changeDetector.setThreshold(threshold);
+    }
+}
 
-    /* ===== Prepare MJPEG frame ===== */
-    std::string imgFrame =
-        "--myboundary\r\n"
-        "Content-Type: image/jpeg\r\n"
-        "Content-Length: ";
+void MjpegServer::setMaxBitrate(int kbps) {
+    m_maxBitrate = kbps * 1000.0;
 
-    std::stringstream ss;
-    ss << m_serveLen;
+    std::lock_guard<std::mutex> lock(m_clientSocketMutex);
+    m_multicastRate.setMaxBitrate(m_maxBitrate);
+}
 
-    imgFrame += ss.str();  // Add image size
-    imgFrame += "\r\n\r\n";
+void MjpegServer::setStageNames(const std::vector<std::string>& names) {
+    m_stageNames = names;
+}
 
-    if (m_buf.length() < imgFrame.length() + m_serveLen + 2) {
-        m_buf.resize(imgFrame.length() + m_serveLen + 2);
+void MjpegServer::enableMulticast(const std::string& group, uint16_t port,
+                                  const std::string& interfaceAddr,
+                                  const std::string& stream) {
+    auto sender = std::make_unique<MulticastSender>(group, port, interfaceAddr);
+    if (!sender->isOpen()) {
+        return;
     }
 
-    m_buf = imgFrame;
-    std::memcpy(&m_buf[0] + imgFrame.length(), m_serveImg, m_serveLen);
-    m_buf[imgFrame.length() + m_serveLen] = '\r';
-    m_buf[imgFrame.length() + m_serveLen + 1] = '\n';
-    /* =============================== */
+    std::lock_guard<std::mutex> lock(m_clientSocketMutex);
+    m_multicast = std::move(sender);
+    m_multicastStream = stream;
+    m_multicastRate.setMaxQuality(k_maxQuality);
+    m_multicastRate.setMaxBitrate(m_maxBitrate);
+}
+
+void MjpegServer::enableH264(int bitrate, int keyframeInterval) {
+#ifdef INSIGHT_WITH_H264
+    m_h264 = std::make_unique<H264Encoder>(bitrate, keyframeInterval);
+#else
+    (void)bitrate;
+    (void)keyframeInterval;
+    std::cout << "MjpegServer: built without H.264 support\n";
+#endif
+}
+
+void MjpegServer::enableRecordStream(uint16_t port,
+                                     const std::string& stream) {
+    m_recordPort = port;
+    m_recordStream = stream;
+}
+
+void MjpegServer::setCaptureTime(std::chrono::steady_clock::time_point time) {
+    m_captureTime = time;
+}
+
+void MjpegServer::setTargetRecord(const std::vector<uint8_t>& record) {
+    auto shared = std::make_shared<const std::vector<uint8_t>>(record);
 
-    // Send JPEG to all clients
     std::lock_guard<std::mutex> lock(m_clientSocketMutex);
-    for (auto i = m_clientSockets.begin(); i != m_clientSockets.end(); i++) {
-        // Loop until every byte has been sent
-        int sent = 0;
-        int sizeToSend = imgFrame.length() + m_serveLen + 2;
-        for (int length = 0; length < sizeToSend; length += sent) {
-            // Send a chunk of data
-            sent = send(*i, &m_buf[0] + length, sizeToSend - length, 0);
-
-            // Check for errors
-            if (sent < 0) {
-                // Close dead socket and remove it from the selector
-                mjpeg_sck_close(*i);
-                m_clientSelector.removeSocket(
-                    *i, mjpeg_sck_selector::read | mjpeg_sck_selector::except);
-
-                // Remove socket from the list of clients
-                i = m_clientSockets.erase(i);
-
-                break;  // Failed to send
-            }
+    m_targetRecord = shared;
+}
+
+bool MjpegServer::hasSubscribers(const std::string& stream) const {
+    std::lock_guard<std::mutex> lock(m_clientSocketMutex);
+    return isStreamed(stream) || isSnapshotRequested(stream);
+}
+
+std::vector<std::string> MjpegServer::getSubscribedStreams() const {
+    std::vector<std::string> streams;
+
+    std::lock_guard<std::mutex> lock(m_clientSocketMutex);
+    if (m_multicast != nullptr) {
+        streams.emplace_back(m_multicastStream);
+    }
+
+    for (auto& client : m_clients) {
+        const std::string& stream =
+            client.stream.empty() ? client.snapshotStream : client.stream;
+        if (!stream.empty() &&
+            std::find(streams.begin(), streams.end(), stream) ==
+                streams.end()) {
+            streams.emplace_back(stream);
         }
     }
+
+    return streams;
+}
+
+std::string MjpegServer::streamFromPath(const std::string& path) {
+    // Ignore any query string
+    std::string name = path.substr(0, path.find('?'));
+
+    if (name == "/" || name == "/annotated") {
+        return "annotated";
+    } else if (name == "/raw") {
+        return "raw";
+    } else if (name == "/mask") {
+        return "mask";
+    } else if (name.compare(0, 7, "/stage/") == 0 && name.length() > 7) {
+        return name.substr(1);
+    } else if (name == "/h264") {
+        return "h264";
+    } else {
+        return "";
+    }
 }
 
 void MjpegServer::serverFunc() {
@@ -231,136 +446,1052 @@ void MjpegServer::serverFunc() {
     int recvSize = 0;
 
     while (m_isRunning) {
+        struct timeval timeout;
+        struct timeval* waitTime = nullptr;
+
+        // Only wait for sockets to become writable if data is queued for them
+        {
+            std::lock_guard<std::mutex> lock(m_clientSocketMutex);
+            for (auto& client : m_clients) {
+                if (client.outQueue.empty()) {
+                    m_clientSelector.removeSocket(client.socket,
+                                                  mjpeg_sck_selector::write);
+                } else {
+                    m_clientSelector.addSocket(client.socket,
+                                               mjpeg_sck_selector::write);
+                }
+            }
+
+            // Wake up when the oldest waiting snapshot request expires
+            auto snapshotWait =
+                expireSnapshots(std::chrono::steady_clock::now());
+            if (snapshotWait >= std::chrono::steady_clock::duration{0}) {
+                auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                              snapshotWait)
+                              .count();
+                timeout.tv_sec = us / 1000000;
+                timeout.tv_usec = us % 1000000;
+                waitTime = &timeout;
+            }
+        }
+
         // Wait until one of the sockets is ready for reading, or timeout is
         // reached
-        int count = m_clientSelector.select(nullptr);
+        int count = m_clientSelector.select(waitTime);
 
         if (count > 0) {
-            // If listener is ready to be read from
-            if (m_clientSelector.isReady(m_listenSock,
-                                         mjpeg_sck_selector::read)) {
-                // Accept a new connection
-                sockaddr_in acceptAddr;
-                socklen_t length = sizeof(acceptAddr);
-                mjpeg_socket_t newClient =
-                    accept(m_listenSock,
-                           reinterpret_cast<sockaddr*>(&acceptAddr), &length);
-
-                // Initialize new socket and add it to the selector
-                if (mjpeg_sck_valid(newClient)) {
-                    mjpeg_sck_setnonblocking(newClient, 0);
-
-                    // Disable the Nagle algorithm (ie. removes buffering of TCP
-                    // packets)
-                    int yes = 1;
-                    if (setsockopt(newClient, IPPROTO_TCP, TCP_NODELAY,
-                                   reinterpret_cast<char*>(&yes),
-                                   sizeof(yes)) == -1) {
-                        mjpeg_sck_close(newClient);
-                        break;  // Failed remove buffering
-                    }
+            // If an exception occurred with the cancel socket, return
+            if (m_cancelfdr && m_clientSelector.isReady(
+                                   m_cancelfdr, mjpeg_sck_selector::except)) {
+                return;
+            }
 
-                    // Add socket to selector
-                    m_clientSockets.push_front(newClient);
-                    m_clientSelector.addSocket(
-                        newClient,
-                        mjpeg_sck_selector::read | mjpeg_sck_selector::except);
+            /* The cancel socket is also written to when data is queued for a
+             * client so the write interest above is updated. Return if it was
+             * written to by stop().
+             */
+            if (m_cancelfdr &&
+                m_clientSelector.isReady(m_cancelfdr,
+                                         mjpeg_sck_selector::read)) {
+                recv(m_cancelfdr, packet, sizeof(packet), 0);
+                if (!m_isRunning) {
+                    return;
                 }
+                continue;
             }
 
-            /* If an exception occurred with the cancel socket or it is ready
-             * to be read, return.
-             */
-            if (m_cancelfdr && (m_clientSelector.isReady(
-                                    m_cancelfdr, mjpeg_sck_selector::except) ||
-                                m_clientSelector.isReady(
-                                    m_cancelfdr, mjpeg_sck_selector::read))) {
-                return;
+            std::lock_guard<std::mutex> lock(m_clientSocketMutex);
+
+            // If a listener is ready to be read from, accept a new connection
+            if (m_clientSelector.isReady(m_listenSock,
+                                         mjpeg_sck_selector::read)) {
+                acceptClient(m_listenSock);
+            }
+            if (mjpeg_sck_valid(m_recordListenSock) &&
+                m_clientSelector.isReady(m_recordListenSock,
+                                         mjpeg_sck_selector::read)) {
+                acceptClient(m_recordListenSock);
             }
 
             // Check if sockets are requesting data stream
-            std::lock_guard<std::mutex> lock(m_clientSocketMutex);
-            for (auto i = m_clientSockets.begin(); i != m_clientSockets.end();
-                 i++) {
+            for (auto i = m_clients.begin(); i != m_clients.end();) {
+                if (m_clientSelector.isReady(i->socket,
+                                             mjpeg_sck_selector::except)) {
+                    i = removeClient(i);
+                    continue;
+                }
+
+                // Send data queued for the client if it can take more
+                if (m_clientSelector.isReady(i->socket,
+                                             mjpeg_sck_selector::write) &&
+                    !flushQueue(*i)) {
+                    i = removeClient(i);
+                    continue;
+                }
+
                 // If current client is ready to be read from
-                if (m_clientSelector.isReady(*i, mjpeg_sck_selector::read)) {
+                if (m_clientSelector.isReady(i->socket,
+                                             mjpeg_sck_selector::read)) {
+                    /* Zero-copy completions on the socket's error queue also
+                     * make it readable, so there may be no request data.
+                     */
+                    reapZeroCopy(*i);
+
                     // Receive a chunk of bytes
-                    recvSize = recv(*i, packet, 255, 0);
-
-                    if (recvSize > 0) {
-                        packet[recvSize] = '\0';
-
-                        /* Parse request to determine the right MJPEG stream to
-                         * send them. It should be "GET %s HTTP/1.0\r\n\r\n"
-                         */
-                        char* tok = std::strtok(packet, " ");
-                        if (std::strncmp(tok, "GET", 3) == 0) {
-                            // Get request path
-                            tok = std::strtok(nullptr, " ");
-
-                            // TODO Finish parsing
-
-                            std::string ack =
-                                "HTTP/1.0 200 OK\r\n"
-                                "Cache-Control: no-cache\r\n"
-                                "Connection: close\r\n"
-                                "Content-Type: multipart/x-mixed-replace; "
-                                "boundary=--myboundary\r\n\r\n";
-
-                            // Loop until every byte has been sent
-                            int sent = 0;
-                            for (unsigned int pos = 0; pos < ack.length();
-                                 pos += sent) {
-                                // Send a chunk of data
-                                sent = send(*i, ack.c_str() + pos,
-                                            ack.length() - pos, 0);
-
-                                // Check for errors
-                                if (sent < 0) {
-                                    /* Close dead socket and remove it from the
-                                     * selector
-                                     */
-                                    mjpeg_sck_close(*i);
-                                    m_clientSelector.removeSocket(
-                                        *i, mjpeg_sck_selector::read |
-                                                mjpeg_sck_selector::except);
-
-                                    // Remove socket from the list of clients
-                                    i = m_clientSockets.erase(i);
-
-                                    break;  // Failed to send
-                                }
+                    recvSize =
+                        mjpeg_sck_recv_available(i->socket, packet, 255);
+
+                    // If socket disconnected or malfunctioned, remove it
+                    if (recvSize == 0) {
+                        i++;
+                        continue;
+                    } else if (recvSize < 0) {
+                        i = removeClient(i);
+                        continue;
+                    }
+
+                    // Streaming clients only send WebSocket control messages
+                    if (!i->stream.empty()) {
+                        if (i->webSocket) {
+                            i->request.append(packet, recvSize);
+                            if (!handleWebSocketMessages(*i)) {
+                                i = removeClient(i);
+                                continue;
                             }
                         }
-                    } else {
-                        // If socket disconnected or malfunctioned, remove it
 
-                        // Close dead socket and remove it from the selector
-                        mjpeg_sck_close(*i);
-                        m_clientSelector.removeSocket(
-                            *i, mjpeg_sck_selector::read |
-                                    mjpeg_sck_selector::except);
+                        i++;
+                        continue;
+                    }
+
+                    // Wait for the rest of the request
+                    i->request.append(packet, recvSize);
+                    if (i->request.find("\r\n\r\n") == std::string::npos) {
+                        if (i->request.length() > k_maxRequestSize) {
+                            i = removeClient(i);
+                            continue;
+                        }
 
-                        // Remove socket from the list of clients
-                        i = m_clientSockets.erase(i);
+                        i++;
+                        continue;
+                    }
 
+                    bool keep = handleRequest(*i, &i->request[0]);
+                    i->request.clear();
+                    if (!keep) {
+                        i = removeClient(i);
                         continue;
                     }
                 }
 
-                if (m_clientSelector.isReady(*i, mjpeg_sck_selector::except)) {
-                    // Close dead socket and remove it from the selector
-                    mjpeg_sck_close(*i);
-                    m_clientSelector.removeSocket(
-                        *i,
-                        mjpeg_sck_selector::read | mjpeg_sck_selector::except);
+                i++;
+            }
+        }
+    }
+}
 
-                    // Remove socket from the list of clients
-                    i = m_clientSockets.erase(i);
+void MjpegServer::acceptClient(mjpeg_socket_t listener) {
+    // Accept a new connection
+    sockaddr_in acceptAddr;
+    socklen_t length = sizeof(acceptAddr);
+    mjpeg_socket_t newClient = accept(
+        listener, reinterpret_cast<sockaddr*>(&acceptAddr), &length);
 
-                    continue;
-                }
+    // Initialize new socket and add it to the selector
+    if (!mjpeg_sck_valid(newClient)) {
+        return;
+    }
+
+    mjpeg_sck_setnonblocking(newClient, 0);
+
+    // Disable the Nagle algorithm (ie. removes buffering of TCP packets)
+    int yes = 1;
+    if (setsockopt(newClient, IPPROTO_TCP, TCP_NODELAY,
+                   reinterpret_cast<char*>(&yes), sizeof(yes)) == -1) {
+        mjpeg_sck_close(newClient);
+        return;
+    }
+
+    // Add socket to selector
+    std::stringstream address;
+    address << inet_ntoa(acceptAddr.sin_addr) << ":"
+            << ntohs(acceptAddr.sin_port);
+    m_clients.emplace_front(newClient, address.str());
+    Client& client = m_clients.front();
+    client.zeroCopy = mjpeg_sck_enable_zerocopy(newClient) == 0;
+    m_clientSelector.addSocket(
+        newClient, mjpeg_sck_selector::read | mjpeg_sck_selector::except);
+
+    if (listener != m_recordListenSock) {
+        return;
+    }
+
+    /* Record clients don't send a request, so subscribe them now. Their
+     * records are queued and sent without blocking.
+     */
+    mjpeg_sck_setnonblocking(newClient, 1);
+    client.record = true;
+    client.rate.setMaxQuality(k_maxQuality);
+    client.rate.setMaxBitrate(m_maxBitrate);
+
+    auto lastFrame = m_lastFrames.find(m_recordStream);
+    if (lastFrame != m_lastFrames.end() &&
+        !sendFrame(client, lastFrame->second)) {
+        removeClient(m_clients.begin());
+        return;
+    }
+
+    client.stream = m_recordStream;
+}
+
+bool MjpegServer::handleRequest(Client& client, char* request) {
+    /* Find the key of a WebSocket upgrade request before the request is
+     * tokenized. Header names are case-insensitive, but the key isn't.
+     */
+    std::string headers = request;
+    std::string lowerHeaders = headers;
+    std::transform(lowerHeaders.begin(), lowerHeaders.end(),
+                   lowerHeaders.begin(), ::tolower);
+
+    std::string webSocketKey;
+    const std::string keyHeader = "\r\nsec-websocket-key:";
+    size_t keyPos = lowerHeaders.find(keyHeader);
+    if (keyPos != std::string::npos) {
+        keyPos = headers.find_first_not_of(" ", keyPos + keyHeader.length());
+        size_t keyEnd = headers.find("\r\n", keyPos);
+        if (keyPos != std::string::npos && keyEnd != std::string::npos) {
+            webSocketKey = headers.substr(keyPos, keyEnd - keyPos);
+        }
+    }
+
+    /* Parse request to determine the right MJPEG stream to send them. It
+     * should be "GET %s HTTP/1.0\r\n\r\n"
+     */
+    char* tok = std::strtok(request, " ");
+    if (tok == nullptr || std::strncmp(tok, "GET", 3) != 0) {
+        // Ignore anything else the client sends after its request
+        return true;
+    }
+
+    // Get request path
+    tok = std::strtok(nullptr, " ");
+    std::string path = tok != nullptr ? tok : "";
+    std::string query;
+    size_t queryStart = path.find('?');
+    if (queryStart != std::string::npos) {
+        query = path.substr(queryStart + 1);
+        path.erase(queryStart);
+    }
+
+    // A path ending in "/snapshot.jpg" requests a single frame
+    bool isSnapshot = false;
+    const std::string snapshotSuffix = "/snapshot.jpg";
+    if (path.length() >= snapshotSuffix.length() &&
+        path.compare(path.length() - snapshotSuffix.length(),
+                     snapshotSuffix.length(), snapshotSuffix) == 0) {
+        isSnapshot = true;
+        path.erase(path.length() - snapshotSuffix.length());
+        if (path.empty()) {
+            path = "/";
+        }
+    }
+
+    if (path == "/metrics") {
+        sendMetrics(client);
+        return false;
+    }
+
+    std::string stream = streamFromPath(path);
+
+    // The H.264 stream has no snapshots and isn't sent over WebSockets
+#ifdef INSIGHT_WITH_H264
+    bool isH264Enabled = m_h264 != nullptr;
+#else
+    bool isH264Enabled = false;
+#endif
+    if (stream == "h264" &&
+        (!isH264Enabled || isSnapshot || !webSocketKey.empty())) {
+        stream.clear();
+    }
+
+    // Stages the processor doesn't have would never produce a frame
+    if (stream.compare(0, 6, "stage/") == 0 &&
+        std::find(m_stageNames.begin(), m_stageNames.end(),
+                  stream.substr(6)) == m_stageNames.end()) {
+        stream.clear();
+    }
+
+    if (stream.empty()) {
+        std::string nack =
+            "HTTP/1.0 404 Not Found\r\n"
+            "Connection: close\r\n"
+            "Content-Type: text/plain\r\n\r\n"
+            "Unknown stream\r\n";
+        sendAll(client.socket, nack.c_str(), nack.length());
+        return false;
+    }
+
+    if (isSnapshot) {
+        return requestSnapshot(client, stream);
+    }
+
+    if (stream == "h264") {
+        std::string ack =
+            "HTTP/1.0 200 OK\r\n"
+            "Cache-Control: no-cache\r\n"
+            "Connection: close\r\n"
+            "Content-Type: video/h264\r\n\r\n";
+        if (!sendAll(client.socket, ack.c_str(), ack.length())) {
+            return false;
+        }
+
+#ifdef INSIGHT_WITH_H264
+        // Make the next frame a keyframe so the client can start decoding
+        m_h264->forceKeyframe();
+#endif
+        client.stream = stream;
+        return true;
+    }
+
+    if (!webSocketKey.empty()) {
+        std::string ack =
+            "HTTP/1.1 101 Switching Protocols\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: Upgrade\r\n"
+            "Sec-WebSocket-Accept: " +
+            WebSocket::acceptKey(webSocketKey) + "\r\n\r\n";
+        if (!sendAll(client.socket, ack.c_str(), ack.length())) {
+            return false;
+        }
+
+        /* Messages are queued and sent without blocking so a slow client
+         * only drops its own frames
+         */
+        mjpeg_sck_setnonblocking(client.socket, 1);
+        client.webSocket = true;
+    } else {
+        std::string ack =
+            "HTTP/1.0 200 OK\r\n"
+            "Cache-Control: no-cache\r\n"
+            "Connection: close\r\n"
+            "Content-Type: multipart/x-mixed-replace; "
+            "boundary=--myboundary\r\n\r\n";
+        if (!sendAll(client.socket, ack.c_str(), ack.length())) {
+            return false;
+        }
+    }
+
+    // Clients may only tighten the server's bitrate limit
+    double maxBitrate = getQueryValue(query, "kbps") * 1000.0;
+    if (m_maxBitrate > 0.0 &&
+        (maxBitrate <= 0.0 || maxBitrate > m_maxBitrate)) {
+        maxBitrate = m_maxBitrate;
+    }
+    client.rate.setMaxQuality(k_maxQuality);
+    client.rate.setMaxBitrate(maxBitrate);
+    client.rate.setMaxFrameRate(getQueryValue(query, "fps"));
+
+    // Send the most recent frame right away instead of waiting for a new one
+    auto lastFrame = m_lastFrames.find(stream);
+    if (lastFrame != m_lastFrames.end() &&
+        !sendFrame(client, lastFrame->second)) {
+        return false;
+    }
+
+    client.stream = stream;
+    return true;
+}
+
+bool MjpegServer::requestSnapshot(Client& client, const std::string& stream) {
+    /* Every frame of a stream with subscribers is encoded, so its cached frame
+     * is current. Otherwise, the next frame is encoded once for the snapshot.
+     */
+    auto lastFrame = m_lastFrames.find(stream);
+    if (lastFrame != m_lastFrames.end() && isStreamed(stream)) {
+        sendSnapshot(client, *lastFrame->second);
+        return false;
+    }
+
+    client.snapshotStream = stream;
+    client.snapshotTime = std::chrono::steady_clock::now();
+    return true;
+}
+
+void MjpegServer::sendSnapshot(Client& client, const Frame& frame) {
+    std::stringstream ss;
+    ss << "HTTP/1.0 200 OK\r\n"
+          "Cache-Control: no-cache\r\n"
+          "Connection: close\r\n"
+          "Content-Type: image/jpeg\r\n"
+          "Content-Length: "
+       << frame.data.size() << "\r\n\r\n";
+    std::string header = ss.str();
+
+    if (sendAll(client.socket, header.c_str(), header.length())) {
+        sendAll(client.socket, reinterpret_cast<const char*>(frame.data.data()),
+                frame.data.size());
+    }
+}
+
+void MjpegServer::answerSnapshots(const std::string& stream,
+                                  const FramePtr& frame) {
+    bool answered = false;
+    for (auto i = m_clients.begin(); i != m_clients.end();) {
+        if (i->snapshotStream != stream) {
+            i++;
+            continue;
+        }
+
+        sendSnapshot(*i, *frame);
+        i = removeClient(i);
+        answered = true;
+    }
+
+    /* The server thread's select() holds the closed sockets open until it
+     * returns, so wake it up to let them close
+     */
+    if (answered) {
+        send(m_cancelfdw, "W", 1, 0);
+    }
+}
+
+std::chrono::steady_clock::duration MjpegServer::expireSnapshots(
+    std::chrono::steady_clock::time_point now) {
+    std::chrono::steady_clock::duration wait{-1};
+
+    for (auto i = m_clients.begin(); i != m_clients.end();) {
+        if (i->snapshotStream.empty()) {
+            i++;
+            continue;
+        }
+
+        // The stream may produce no frames, such as when the source stopped
+        auto remaining = i->snapshotTime + k_snapshotTimeout - now;
+        if (remaining <= std::chrono::steady_clock::duration{0}) {
+            std::string nack =
+                "HTTP/1.0 503 Service Unavailable\r\n"
+                "Connection: close\r\n"
+                "Content-Type: text/plain\r\n\r\n"
+                "No frame available\r\n";
+            sendAll(i->socket, nack.c_str(), nack.length());
+            i = removeClient(i);
+            continue;
+        }
+
+        if (wait < std::chrono::steady_clock::duration{0} || remaining < wait) {
+            wait = remaining;
+        }
+        i++;
+    }
+
+    return wait;
+}
+
+bool MjpegServer::isStreamed(const std::string& stream) const {
+    if (m_multicast != nullptr && stream == m_multicastStream) {
+        return true;
+    }
+
+    for (auto& client : m_clients) {
+        if (client.stream == stream) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool MjpegServer::isSnapshotRequested(const std::string& stream) const {
+    for (auto& client : m_clients) {
+        if (client.snapshotStream == stream) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::shared_ptr<MjpegServer::Frame> MjpegServer::encodeFrame(
+    const uint8_t* image, unsigned int width, unsigned int height,
+    unsigned int channels, int quality) {
+    auto startTime = std::chrono::steady_clock::now();
+
+    auto frame = std::make_shared<Frame>();
+    m_encoder.setQuality(quality);
+    if (!m_encoder.encode(image, width, height, channels, frame->data)) {
+        return nullptr;
+    }
+
+    Metrics::addLatency(Metrics::Stage::encode,
+                        std::chrono::steady_clock::now() - startTime);
+    Metrics::add(Metrics::Counter::framesEncoded);
+    Metrics::add(Metrics::Counter::bytesEncoded, frame->data.size());
+
+    /* The multipart header is formatted once per frame. Each client is sent
+     * it and the JPEG straight from the shared frame rather than from a copy.
+     */
+    frame->partHeader = makePartHeader(frame->data.size());
+
+    return frame;
+}
+
+std::vector<int> MjpegServer::getReadyQualities(
+    const std::string& stream, std::chrono::steady_clock::time_point now,
+    bool targetsOnly) {
+    std::vector<int> qualities;
+    for (auto& client : m_clients) {
+        if (client.stream == stream && client.outQueue.empty() &&
+            client.rate.isReady(now) &&
+            (!targetsOnly || client.record || client.webSocket) &&
+            std::find(qualities.begin(), qualities.end(),
+                      client.rate.getQuality()) == qualities.end()) {
+            qualities.emplace_back(client.rate.getQuality());
+        }
+    }
+
+    if (!targetsOnly && m_multicast != nullptr && stream == m_multicastStream &&
+        m_multicastRate.isReady(now) &&
+        std::find(qualities.begin(), qualities.end(),
+                  m_multicastRate.getQuality()) == qualities.end()) {
+        qualities.emplace_back(m_multicastRate.getQuality());
+    }
+
+    return qualities;
+}
+
+void MjpegServer::repeatFrame(
+    const std::string& stream, const std::map<int, FramePtr>& frames,
+    uint32_t id, std::chrono::steady_clock::time_point captureTime,
+    bool keepAlive, std::chrono::steady_clock::time_point now) {
+    // Frames are shared with other clients, so restamped ones are copies
+    std::map<int, FramePtr> restamped;
+
+    for (auto i = m_clients.begin(); i != m_clients.end();) {
+        bool sendsTargets = i->record || i->webSocket;
+        auto frame = frames.find(i->rate.getQuality());
+        if (i->stream != stream || (!sendsTargets && !keepAlive) ||
+            frame == frames.end() || !i->rate.isReady(now)) {
+            i++;
+            continue;
+        }
+
+        FramePtr sent = frame->second;
+        if (sendsTargets) {
+            auto& copy = restamped[frame->first];
+            if (copy == nullptr) {
+                auto newFrame = std::make_shared<Frame>(*frame->second);
+                newFrame->id = id;
+                newFrame->captureTime = captureTime;
+                copy = newFrame;
+            }
+            sent = copy;
+        }
+
+        if (!sendFrame(*i, sent)) {
+            Metrics::drop(Metrics::DropReason::sendFailed);
+            i = removeClient(i);
+            continue;
+        }
+
+        i++;
+    }
+
+    if (keepAlive && m_multicast != nullptr && stream == m_multicastStream) {
+        auto frame = frames.find(m_multicastRate.getQuality());
+        if (frame != frames.end() && m_multicastRate.isReady(now)) {
+            sendMulticast(frame->second, now);
+        }
+    }
+}
+
+std::chrono::steady_clock::time_point MjpegServer::getCaptureTime(
+    std::chrono::steady_clock::time_point now) const {
+    return m_captureTime != std::chrono::steady_clock::time_point()
+               ? m_captureTime
+               : now;
+}
+
+void MjpegServer::sendMulticast(const FramePtr& frame,
+                                std::chrono::steady_clock::time_point now) {
+    if (!m_multicast->send(frame->data)) {
+        Metrics::drop(Metrics::DropReason::sendFailed);
+        return;
+    }
+
+    size_t fragments =
+        (frame->data.size() + MulticastPacket::k_maxPayload - 1) /
+        MulticastPacket::k_maxPayload;
+    size_t total =
+        frame->data.size() + fragments * MulticastPacket::k_headerSize;
+
+    Metrics::add(Metrics::Counter::framesSent);
+    Metrics::add(Metrics::Counter::bytesSent, total);
+    m_multicastRate.consume(total, now);
+}
+
+bool MjpegServer::sendFrame(Client& client, const FramePtr& frame) {
+    if (client.webSocket) {
+        return sendWebSocketFrame(client, frame);
+    } else if (client.record) {
+        return sendRecordFrame(client, frame);
+    }
+
+    // Release frames from earlier sends so they don't pile up
+    reapZeroCopy(client);
+
+    mjpeg_iovec iov[3] = {
+        {frame->partHeader.data(), frame->partHeader.length()},
+        {frame->data.data(), frame->data.size()},
+        {"\r\n", frame->partHeader.empty() ? 0u : 2u}};
+    size_t total = iov[0].len + iov[1].len + iov[2].len;
+
+    bool zeroCopy =
+        client.zeroCopy && frame->data.size() >= k_zeroCopyThreshold;
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    // Loop until every byte has been sent, skipping past partial writes
+    int first = 0;
+    while (first < 3) {
+        int sent = mjpeg_sck_sendv(client.socket, iov + first, 3 - first,
+                                   zeroCopy);
+        if (sent < 0) {
+            // The socket's pinned-memory limit was hit, so fall back to copying
+            if (zeroCopy && mjpeg_sck_zerocopy_nobufs()) {
+                zeroCopy = false;
+                continue;
+            }
+            return false;
+        }
+
+        if (zeroCopy) {
+            client.zeroCopyFrames.emplace_back(client.nextZeroCopyId++, frame);
+        }
+
+        for (size_t remaining = sent; first < 3; first++) {
+            if (remaining < iov[first].len) {
+                iov[first].base =
+                    static_cast<const char*>(iov[first].base) + remaining;
+                iov[first].len -= remaining;
+                break;
             }
+            remaining -= iov[first].len;
         }
     }
+
+    Metrics::addLatency(Metrics::Stage::send,
+                        std::chrono::steady_clock::now() - startTime);
+    Metrics::add(Metrics::Counter::framesSent);
+    Metrics::add(Metrics::Counter::bytesSent, total);
+    client.framesSent++;
+    client.bytesSent += total;
+    client.rate.consume(total, startTime);
+
+    return true;
+}
+
+bool MjpegServer::sendWebSocketFrame(Client& client, const FramePtr& frame) {
+    // Drop the frame if the client hasn't taken the previous one yet
+    if (!client.outQueue.empty()) {
+        Metrics::drop(Metrics::DropReason::clientBehind);
+        return true;
+    }
+
+    auto jpegHeader = std::make_shared<const std::string>(
+        WebSocket::frameHeader(WebSocket::Opcode::binary, frame->data.size()));
+    client.outQueue.push_back(
+        {jpegHeader, reinterpret_cast<const uint8_t*>(jpegHeader->data()),
+         jpegHeader->length()});
+    client.outQueue.push_back({frame, frame->data.data(), frame->data.size()});
+
+    if (m_targetRecord != nullptr) {
+        auto recordHeader =
+            std::make_shared<const std::string>(WebSocket::frameHeader(
+                WebSocket::Opcode::binary, m_targetRecord->size()));
+        client.outQueue.push_back(
+            {recordHeader,
+             reinterpret_cast<const uint8_t*>(recordHeader->data()),
+             recordHeader->length()});
+        client.outQueue.push_back({m_targetRecord, m_targetRecord->data(),
+                                   m_targetRecord->size()});
+    }
+
+    size_t total = 0;
+    for (auto& chunk : client.outQueue) {
+        total += chunk.length;
+    }
+
+    if (!flushQueue(client)) {
+        return false;
+    }
+
+    // Have the server thread send the rest once the socket is writable
+    if (!client.outQueue.empty()) {
+        send(m_cancelfdw, "W", 1, 0);
+    }
+
+    Metrics::add(Metrics::Counter::framesSent);
+    Metrics::add(Metrics::Counter::bytesSent, total);
+    client.framesSent++;
+    client.bytesSent += total;
+    client.rate.consume(total, std::chrono::steady_clock::now());
+
+    return true;
+}
+
+bool MjpegServer::sendRecordFrame(Client& client, const FramePtr& frame) {
+    // Drop the frame if the client hasn't taken the previous one yet
+    if (!client.outQueue.empty()) {
+        Metrics::drop(Metrics::DropReason::clientBehind);
+        return true;
+    }
+
+    // The capture time is sent as wall clock time so other hosts can use it
+    auto captureTime =
+        std::chrono::system_clock::now() -
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::steady_clock::now() - frame->captureTime);
+
+    FrameRecord record;
+    record.frameId = frame->id;
+    record.timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
+                           captureTime.time_since_epoch())
+                           .count();
+    record.targetsSize = m_targetRecord != nullptr ? m_targetRecord->size() : 0;
+    record.jpegSize = frame->data.size();
+
+    auto header = std::make_shared<std::vector<uint8_t>>(
+        FrameRecord::k_headerSize);
+    record.pack(header->data());
+
+    client.outQueue.push_back({header, header->data(), header->size()});
+    if (m_targetRecord != nullptr) {
+        client.outQueue.push_back({m_targetRecord, m_targetRecord->data(),
+                                   m_targetRecord->size()});
+    }
+    client.outQueue.push_back({frame, frame->data.data(), frame->data.size()});
+
+    size_t total =
+        FrameRecord::k_headerSize + record.targetsSize + record.jpegSize;
+
+    if (!flushQueue(client)) {
+        return false;
+    }
+
+    // Have the server thread send the rest once the socket is writable
+    if (!client.outQueue.empty()) {
+        send(m_cancelfdw, "W", 1, 0);
+    }
+
+    Metrics::add(Metrics::Counter::framesSent);
+    Metrics::add(Metrics::Counter::bytesSent, total);
+    client.framesSent++;
+    client.bytesSent += total;
+    client.rate.consume(total, std::chrono::steady_clock::now());
+
+    return true;
+}
+
+bool MjpegServer::handleWebSocketMessages(Client& client) {
+    WebSocket::Opcode opcode;
+    std::string payload;
+
+    // Messages may be split across reads or several may arrive in one
+    size_t used;
+    while ((used = WebSocket::parseFrame(client.request.data(),
+                                         client.request.length(), opcode,
+                                         payload)) > 0) {
+        client.request.erase(0, used);
+
+        if (opcode == WebSocket::Opcode::ping) {
+            queueControlMessage(client, WebSocket::Opcode::pong, payload);
+            if (!flushQueue(client)) {
+                return false;
+            }
+        } else if (opcode == WebSocket::Opcode::close) {
+            /* Echo the status code before closing the connection. Whatever
+             * the socket doesn't take without blocking is dropped with it.
+             */
+            queueControlMessage(client, WebSocket::Opcode::close,
+                                payload.substr(0, 2));
+            flushQueue(client);
+            return false;
+        }
+    }
+
+    // Nothing the viewer sends should be larger than a request
+    return client.request.length() <= k_maxRequestSize;
+}
+
+void MjpegServer::queueControlMessage(Client& client, WebSocket::Opcode opcode,
+                                      const std::string& payload) {
+    auto message = std::make_shared<const std::string>(
+        WebSocket::frameHeader(opcode, payload.length()) + payload);
+    client.outQueue.push_back(
+        {message, reinterpret_cast<const uint8_t*>(message->data()),
+         message->length()});
+}
+
+bool MjpegServer::flushQueue(Client& client) {
+    constexpr int k_maxChunks = 16;
+
+    while (!client.outQueue.empty()) {
+        mjpeg_iovec iov[k_maxChunks];
+        int count = 0;
+        for (auto& chunk : client.outQueue) {
+            if (count == k_maxChunks) {
+                break;
+            }
+            iov[count] = {chunk.data, chunk.length};
+            count++;
+        }
+
+        int sent = mjpeg_sck_sendv(client.socket, iov, count, 0);
+        if (sent < 0) {
+            // The socket's buffer is full, so wait until it's writable again
+            return mjpeg_sck_geterror() == SCK_NOTREADY;
+        }
+
+        // Remove what was sent from the queue
+        size_t remaining = sent;
+        while (remaining > 0) {
+            Chunk& chunk = client.outQueue.front();
+            if (remaining < chunk.length) {
+                chunk.data += remaining;
+                chunk.length -= remaining;
+                break;
+            }
+            remaining -= chunk.length;
+            client.outQueue.pop_front();
+        }
+    }
+
+    return true;
+}
+
+void MjpegServer::reapZeroCopy(Client& client) {
+    uint32_t lo;
+    uint32_t hi;
+    int copied;
+    while (!client.zeroCopyFrames.empty() &&
+           mjpeg_sck_zerocopy_reap(client.socket, &lo, &hi, &copied) == 1) {
+        /* Completions arrive in order, so every pending send up to 'hi' is
+         * finished. The comparison tolerates the IDs wrapping around.
+         */
+        while (!client.zeroCopyFrames.empty() &&
+               static_cast<int32_t>(hi - client.zeroCopyFrames.front().first) >=
+                   0) {
+            client.zeroCopyFrames.pop_front();
+        }
+
+        /* The kernel copied the data anyway (e.g., over loopback), so pinning
+         * the pages is pure overhead for this client
+         */
+        if (copied) {
+            client.zeroCopy = false;
+        }
+    }
+}
+
+std::list<MjpegServer::Client>::iterator MjpegServer::removeClient(
+    std::list<Client>::iterator i) {
+    // Close dead socket and remove it from the selector
+    mjpeg_sck_close(i->socket);
+    m_clientSelector.removeSocket(i->socket, mjpeg_sck_selector::read |
+                                                 mjpeg_sck_selector::write |
+                                                 mjpeg_sck_selector::except);
+
+    // Remove socket from the list of clients
+    return m_clients.erase(i);
+}
+
+void MjpegServer::sendMetrics(Client& client) {
+    std::stringstream ss;
+    ss << Metrics::format();
+
+    ss << "# TYPE insight_client_frames_sent_total counter\n";
+    for (auto& other : m_clients) {
+        if (!other.stream.empty()) {
+            ss << "insight_client_frames_sent_total{client=\"" << other.address
+               << "\",stream=\"" << other.stream << "\"} "
+               << other.framesSent << "\n";
+        }
+    }
+
+    ss << "# TYPE insight_client_sent_bytes_total counter\n";
+    for (auto& other : m_clients) {
+        if (!other.stream.empty()) {
+            ss << "insight_client_sent_bytes_total{client=\"" << other.address
+               << "\",stream=\"" << other.stream << "\"} " << other.bytesSent
+               << "\n";
+        }
+    }
+
+    // Bytes the kernel has queued for the client but the client hasn't acked
+    ss << "# TYPE insight_client_queued_bytes gauge\n";
+    for (auto& other : m_clients) {
+        int queued = mjpeg_sck_outq(other.socket);
+        if (!other.stream.empty() && queued >= 0) {
+            ss << "insight_client_queued_bytes{client=\"" << other.address
+               << "\",stream=\"" << other.stream << "\"} " << queued << "\n";
+        }
+    }
+
+    auto now = std::chrono::steady_clock::now();
+
+    ss << "# TYPE insight_client_bitrate_bits_per_second gauge\n";
+    for (auto& other : m_clients) {
+        if (!other.stream.empty()) {
+            ss << "insight_client_bitrate_bits_per_second{client=\""
+               << other.address << "\",stream=\"" << other.stream << "\"} "
+               << other.rate.getBitrate(now) << "\n";
+        }
+    }
+
+    if (m_multicast != nullptr) {
+        ss << "insight_client_bitrate_bits_per_second{client=\""
+           << m_multicast->getAddress() << "\",stream=\"" << m_multicastStream
+           << "\"} " << m_multicastRate.getBitrate(now) << "\n";
+    }
+
+    ss << "# TYPE insight_client_max_bitrate_bits_per_second gauge\n";
+    for (auto& other : m_clients) {
+        if (!other.stream.empty() && other.rate.getMaxBitrate() > 0.0) {
+            ss << "insight_client_max_bitrate_bits_per_second{client=\""
+               << other.address << "\",stream=\"" << other.stream << "\"} "
+               << other.rate.getMaxBitrate() << "\n";
+        }
+    }
+
+    ss << "# TYPE insight_client_jpeg_quality gauge\n";
+    for (auto& other : m_clients) {
+        if (!other.stream.empty()) {
+            ss << "insight_client_jpeg_quality{client=\"" << other.address
+               << "\",stream=\"" << other.stream << "\"} "
+               << other.rate.getQuality() << "\n";
+        }
+    }
+
+    if (m_multicast != nullptr) {
+        ss << "insight_client_jpeg_quality{client=\""
+           << m_multicast->getAddress() << "\",stream=\"" << m_multicastStream
+           << "\"} " << m_multicastRate.getQuality() << "\n";
+    }
+
+    std::string body = ss.str();
+
+    ss.str("");
+    ss << "HTTP/1.0 200 OK\r\n"
+          "Cache-Control: no-cache\r\n"
+          "Connection: close\r\n"
+          "Content-Type: text/plain; version=0.0.4\r\n"
+          "Content-Length: "
+       << body.length() << "\r\n\r\n"
+       << body;
+    std::string response = ss.str();
+
+    sendAll(client.socket, response.c_str(), response.length());
+}
+
+double MjpegServer::getQueryValue(const std::string& query,
+                                  const std::string& key) {
+    // Parameters are separated by '&' and have the form "key=value"
+    size_t pos = 0;
+    while (pos < query.length()) {
+        size_t end = query.find('&', pos);
+        if (end == std::string::npos) {
+            end = query.length();
+        }
+
+        if (query.compare(pos, key.length() + 1, key + "=") == 0) {
+            pos += key.length() + 1;
+            return std::atof(query.substr(pos, end - pos).c_str());
+        }
+
+        pos = end + 1;
+    }
+
+    return 0.0;
+}
+
+std::string MjpegServer::makePartHeader(size_t jpegSize) {
+    std::stringstream ss;
+    ss << "--myboundary\r\n"
+          "Content-Type: image/jpeg\r\n"
+          "Content-Length: "
+       << jpegSize << "\r\n\r\n";
+
+    return ss.str();
+}
+
+mjpeg_socket_t MjpegServer::openListener(uint16_t port) {
+    mjpeg_socket_t sd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (mjpeg_sck_valid(sd)) {
+        mjpeg_sck_setnonblocking(sd, 0);
+
+        /* Disable the Nagle algorithm (ie. removes buffering of TCP
+         * packets)
+         */
+        int yes = 1;
+        if (setsockopt(sd, IPPROTO_TCP, TCP_NODELAY,
+                       reinterpret_cast<char*>(&yes), sizeof(yes)) == -1) {
+            mjpeg_sck_close(sd);
+            std::cout << "MjpegServer: failed to remove TCP buffering\n";
+            return INVALID_SOCKET;  // Failed to remove buffering
+        }
+
+        // Allow reconnecting to the same port after server restart
+        if (setsockopt(sd, SOL_SOCKET, SO_REUSEADDR,
+                       reinterpret_cast<char*>(&yes), sizeof(yes)) == -1) {
+            mjpeg_sck_close(sd);
+            std::cout << "MjpegServer: failed to remove TCP buffering\n";
+            return INVALID_SOCKET;  // Failed to remove buffering
+        }
+    } else {
+        std::cout << "MjpegServer: failed to create listener socket\n";
+        return INVALID_SOCKET;  // Failed to create socket
+    }
+
+    // Bind the socket to the specified port
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+
+    if (bind(sd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) ==
+        -1) {
+        mjpeg_sck_close(sd);
+        std::cout << "MjpegServer: failed to bind socket to port\n";
+        return INVALID_SOCKET;  // Failed to bind socket to port
+    }
+
+    // Listen to the bound port
+    if (listen(sd, 0) == -1) {
+        mjpeg_sck_close(sd);
+        std::cout << "MjpegServer: failed to listen to port " << port << "\n";
+        return INVALID_SOCKET;  // Failed to listen to port
+    }
+
+    std::cout << "Started listening on " << port << "\n";
+
+    return sd;
+}
+
+bool MjpegServer::sendAll(mjpeg_socket_t sd, const char* data,
+                          size_t length) {
+    // Loop until every byte has been sent
+    int sent = 0;
+    for (size_t pos = 0; pos < length; pos += sent) {
+        // Send a chunk of data
+        sent = send(sd, data + pos, length - pos, 0);
+
+        // Check for errors
+        if (sent < 0) {
+            return false;  // Failed to send
+        }
+    }
+
+    return true;
 }
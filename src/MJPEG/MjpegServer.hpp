@@ -5,13 +5,25 @@
 #include <stdint.h>
 
 #include <atomic>
+#include <chrono>
+#include <deque>
 #include <list>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <utility>
+#include <vector>
 
-#include <jpeglib.h>
-
+#include "ChangeDetector.hpp"
+#ifdef INSIGHT_WITH_H264
+#include "H264Encoder.hpp"
+#endif
+#include "JpegEncoder.hpp"
+#include "MulticastSender.hpp"
+#include "RateController.hpp"
+#include "WebSocket.hpp"
 #include "mjpeg_sck_selector.hpp"
 
 /**
@@ -19,23 +31,225 @@
  */
 class MjpegServer {
 public:
-    explicit MjpegServer(uint16_t port);
+    /* 'encodeThreads' is the number of threads used to compress each frame. A
+     * value of 0 uses one thread per hardware core.
+     */
+    explicit MjpegServer(uint16_t port, unsigned int encodeThreads = 1);
     virtual ~MjpegServer();
 
     void start();
     void stop();
 
-    // Converts BGR image to JPEG before serving it
-    void serveImage(uint8_t* image, unsigned int width, unsigned int height);
+    /* Converts BGR or grayscale image to JPEG before serving it on the
+     * "annotated" stream. Only BGR images are served on the H.264 stream.
+     */
+    void serveImage(uint8_t* image, unsigned int width, unsigned int height,
+                    unsigned int channels = 3);
+
+    /* Converts image to JPEG before serving it to clients subscribed to the
+     * given stream. 'channels' is 3 for a BGR image or 1 for a grayscale one.
+     */
+    void serveImage(const std::string& stream, const uint8_t* image,
+                    unsigned int width, unsigned int height,
+                    unsigned int channels);
+
+    /* Frames whose block means all moved by no more than this many intensity
+     * levels since the last encoded frame aren't encoded. Clients are sent the
+     * previous frame again at a reduced rate instead. 0 disables the check.
+     */
+    void setChangeThreshold(int threshold);
+
+    /* Sets the default bitrate limit of each client in kilobits per second. 0
+     * removes the limit. Clients may request a lower one.
+     */
+    void setMaxBitrate(int kbps);
+
+    /* Sets the names of the stages served under "/stage/<name>". Requests for
+     * other stages are answered with 404 Not Found. This must be called before
+     * start().
+     */
+    void setStageNames(const std::vector<std::string>& names);
+
+    /* Also sends the given stream's frames to a UDP multicast group, fragmented
+     * as described by MulticastPacket. They are subject to the default client
+     * bitrate limit. 'interfaceAddr' is the IPv4 address of the local
+     * interface to send on; an empty string uses the default route.
+     */
+    void enableMulticast(const std::string& group, uint16_t port,
+                         const std::string& interfaceAddr,
+                         const std::string& stream = "annotated");
+
+    /* Also compresses annotated frames into an H.264 stream served at
+     * "/h264" while it has subscribers. 'bitrate' is in kilobits per second,
+     * and 'keyframeInterval' is the maximum number of frames between
+     * keyframes. Has no effect unless Insight was built with H.264 support.
+     */
+    void enableH264(int bitrate, int keyframeInterval);
+
+    /* Also serves the given stream on its own port as a sequence of binary
+     * records, each a FrameRecord header followed by the target record and the
+     * JPEG. Record clients don't send a request; they're subscribed as soon as
+     * they connect. Like WebSocket clients, they never block the server, and
+     * frames are dropped while a client is still receiving the previous one.
+     * This must be called before start().
+     */
+    void enableRecordStream(uint16_t port,
+                            const std::string& stream = "annotated");
+
+    /* Sets the time at which the next image served was captured. It's sent
+     * with each frame on the record stream.
+     */
+    void setCaptureTime(std::chrono::steady_clock::time_point time);
+
+    /* Sets the target record sent to WebSocket clients after each frame. See
+     * ProcBase::getTargetRecord() for its format.
+     */
+    void setTargetRecord(const std::vector<uint8_t>& record);
+
+    /* Returns true if at least one client is subscribed to the given stream or
+     * is waiting for a snapshot of it
+     */
+    bool hasSubscribers(const std::string& stream) const;
+
+    // Returns the names of all streams for which hasSubscribers() is true
+    std::vector<std::string> getSubscribedStreams() const;
+
+    /* Returns the stream name for a request path, or an empty string if the
+     * path doesn't name a stream. A query string is ignored. Paths are mapped
+     * as follows:
+     *
+     * "/" and "/annotated" -> "annotated"
+     * "/raw"               -> "raw"
+     * "/mask"              -> "mask"
+     * "/stage/<name>"      -> "stage/<name>"
+     * "/h264"              -> "h264"
+     *
+     * "/h264" is a raw H.264 Annex-B byte stream rather than MJPEG.
+     *
+     * "/metrics" returns the program's performance counters as plain text.
+     *
+     * Appending "/snapshot.jpg" to any of these paths (or requesting
+     * "/snapshot.jpg" for the annotated stream) returns the stream's most
+     * recent frame as a single JPEG instead of an MJPEG stream. If the stream
+     * isn't being encoded for subscribers, the next frame is encoded once for
+     * the snapshot. If none arrives within k_snapshotTimeout, the request is
+     * answered with 503 Service Unavailable.
+     *
+     * A WebSocket upgrade request for a stream path subscribes the client to
+     * the stream over WebSocket instead. Each frame is sent as a binary
+     * message followed by a binary message holding the target record. Frames
+     * are queued without blocking and dropped while a client is still
+     * receiving the previous one.
+     *
+     * Streams accept "fps" and "kbps" query parameters (e.g.,
+     * "/raw?fps=10&kbps=1500") which cap the client's frame rate and bitrate.
+     */
+    static std::string streamFromPath(const std::string& path);
 
 private:
+    // Quality of frames sent to clients without a bitrate limit
+    static constexpr int k_maxQuality = 100;
+
+    // Requests longer than this are rejected
+    static constexpr size_t k_maxRequestSize = 8192;
+
+    // How often an unchanged stream's last frame is sent again
+    static constexpr std::chrono::seconds k_repeatInterval{1};
+
+    /* Longest a snapshot request waits for a frame. Streams with subscribers
+     * produce one at least every k_repeatInterval.
+     */
+    static constexpr std::chrono::seconds k_snapshotTimeout{2};
+
+    /* JPEGs at least this large are sent with MSG_ZEROCOPY where supported.
+     * Below it, pinning the pages costs more than copying them.
+     */
+    static constexpr size_t k_zeroCopyThreshold = 16384;
+
+    /* An encoded frame and the multipart header which precedes it. Frames
+     * without a multipart header are sent as part of a raw byte stream.
+     */
+    struct Frame {
+        std::vector<uint8_t> data;
+        std::string partHeader;
+
+        // Position of the image in its stream and the time it was captured
+        uint32_t id = 0;
+        std::chrono::steady_clock::time_point captureTime;
+    };
+    typedef std::shared_ptr<const Frame> FramePtr;
+
+    // Data queued for sending; 'owner' keeps it alive until it's sent
+    struct Chunk {
+        std::shared_ptr<const void> owner;
+        const uint8_t* data;
+        size_t length;
+    };
+
+    struct Client {
+        Client(mjpeg_socket_t sd, const std::string& addr)
+            : socket(sd), address(addr) {}
+
+        mjpeg_socket_t socket;
+
+        // Remote address as "ip:port"
+        std::string address;
+
+        // Request received so far; cleared once it's complete
+        std::string request;
+
+        // Name of the stream requested; empty until the request is parsed
+        std::string stream;
+
+        /* Stream of which the client requested a snapshot and is waiting for
+         * the next frame, or empty
+         */
+        std::string snapshotStream;
+
+        // Time at which the snapshot was requested
+        std::chrono::steady_clock::time_point snapshotTime;
+
+        // True if the client upgraded the connection to a WebSocket
+        bool webSocket = false;
+
+        // True if the client connected to the record stream's port
+        bool record = false;
+
+        // H.264 clients can only start decoding at a keyframe
+        bool waitingForKeyframe = true;
+
+        // Messages queued for a WebSocket client which haven't been sent yet
+        std::deque<Chunk> outQueue;
+
+        uint64_t framesSent = 0;
+        uint64_t bytesSent = 0;
+
+        RateController rate;
+
+        // True if MSG_ZEROCOPY sends are enabled for the socket
+        bool zeroCopy = false;
+
+        // ID the kernel will assign to the next zero-copy send
+        uint32_t nextZeroCopyId = 0;
+
+        /* Frames referenced by zero-copy sends the kernel hasn't completed
+         * yet, keyed by send ID. They are kept alive until then.
+         */
+        std::deque<std::pair<uint32_t, FramePtr>> zeroCopyFrames;
+    };
+
     mjpeg_sck_selector m_clientSelector;
-    std::list<mjpeg_socket_t> m_clientSockets;
-    std::mutex m_clientSocketMutex;
+    std::list<Client> m_clients;
+    mutable std::mutex m_clientSocketMutex;
 
     mjpeg_socket_t m_listenSock = INVALID_SOCKET;
     uint16_t m_port;
 
+    // Listener for record stream clients; disabled if the port is 0
+    mjpeg_socket_t m_recordListenSock = INVALID_SOCKET;
+    uint16_t m_recordPort = 0;
+    std::string m_recordStream;
+
     mjpeg_socket_t m_cancelfdr = 0;
     mjpeg_socket_t m_cancelfdw = 0;
 
@@ -43,13 +257,202 @@ private:
     void serverFunc();
     std::atomic<bool> m_isRunning{false};
 
-    // Temporary buffer used in serveImage()
-    std::string m_buf;
+    JpegEncoder m_encoder;
+
+    std::shared_ptr<const std::vector<uint8_t>> m_targetRecord;
+
+    // Only used by the thread calling serveImage()
+    std::chrono::steady_clock::time_point m_captureTime;
+
+#ifdef INSIGHT_WITH_H264
+    // Only used by the thread calling serveImage() after it's created
+    std::unique_ptr<H264Encoder> m_h264;
+
+    // Compresses the image into H.264 and sends it to "h264" subscribers
+    void serveH264(const uint8_t* image, unsigned int width,
+                   unsigned int height);
+#endif
+
+    /* Most recently encoded frame of each stream. They are sent to new
+     * subscribers right away and returned by snapshot requests.
+     */
+    std::map<std::string, FramePtr> m_lastFrames;
+
+    // Per-stream state only used by the thread calling serveImage()
+    struct StreamState {
+        ChangeDetector changeDetector;
+
+        // Time of the last frame sent to clients
+        std::chrono::steady_clock::time_point sendTime;
+
+        // Time of the last call to serveImage() and the average rate of calls
+        std::chrono::steady_clock::time_point serveTime;
+        double frameRate = 0.0;
+
+        // ID assigned to the next image encoded
+        uint32_t nextFrameId = 0;
+
+        /* Frames of the last image encoded by quality. Unchanged images are
+         * repeated from these.
+         */
+        std::map<int, FramePtr> frames;
+    };
+
+    int m_changeThreshold = 0;
+    std::map<std::string, StreamState> m_streamStates;
+
+    // Default bitrate limit of each client in bits per second
+    double m_maxBitrate = 0.0;
+
+    // Stages which can be requested with "/stage/<name>"
+    std::vector<std::string> m_stageNames;
+
+    /* Multicast group to which frames of m_multicastStream are sent, if any.
+     * Its rate controller is guarded by the client socket mutex.
+     */
+    std::unique_ptr<MulticastSender> m_multicast;
+    std::string m_multicastStream;
+    RateController m_multicastRate;
+
+    /* Accepts a connection on the given listening socket. Record stream
+     * clients are subscribed right away. The client socket mutex must be
+     * held.
+     */
+    void acceptClient(mjpeg_socket_t listener);
+
+    /* Parses a client's request and subscribes it to the requested stream.
+     * Returns false if the client should be disconnected.
+     */
+    bool handleRequest(Client& client, char* request);
+
+    /* Parses the WebSocket messages a streaming client has sent so far.
+     * Pings are answered with pongs and close messages are echoed. Returns
+     * false if the client should be disconnected.
+     */
+    bool handleWebSocketMessages(Client& client);
+
+    // Queues a control message for a WebSocket client
+    void queueControlMessage(Client& client, WebSocket::Opcode opcode,
+                             const std::string& payload);
+
+    /* Answers a snapshot request with the stream's cached frame if the stream
+     * is being encoded for subscribers. Otherwise, the client waits for the
+     * next frame. Returns false if the client should be disconnected.
+     */
+    bool requestSnapshot(Client& client, const std::string& stream);
+
+    // Sends the frame as a single JPEG
+    void sendSnapshot(Client& client, const Frame& frame);
+
+    /* Sends the frame to the clients waiting for a snapshot of the stream and
+     * disconnects them. The client socket mutex must be held.
+     */
+    void answerSnapshots(const std::string& stream, const FramePtr& frame);
+
+    /* Answers snapshot requests which have waited longer than
+     * k_snapshotTimeout with 503 Service Unavailable and disconnects them.
+     * Returns how long the oldest remaining request may still wait, or a
+     * negative duration if none are waiting. The client socket mutex must be
+     * held.
+     */
+    std::chrono::steady_clock::duration expireSnapshots(
+        std::chrono::steady_clock::time_point now);
+
+    /* Returns true if a streaming client or the multicast group is subscribed
+     * to the stream. The client socket mutex must be held.
+     */
+    bool isStreamed(const std::string& stream) const;
+
+    /* Returns true if a client is waiting for a snapshot of the stream. The
+     * client socket mutex must be held.
+     */
+    bool isSnapshotRequested(const std::string& stream) const;
+
+    // Sends program-wide metrics followed by per-client statistics
+    void sendMetrics(Client& client);
+
+    /* Sends each client subscribed to the stream whose rate limits allow it
+     * the frame encoded at its quality. Record and WebSocket clients are sent
+     * copies carrying 'id' and 'captureTime', since the target record sent
+     * with them is the current image's. Other clients and the multicast group
+     * are only sent the frame if 'keepAlive' is true. The client socket mutex
+     * must be held.
+     */
+    void repeatFrame(const std::string& stream,
+                     const std::map<int, FramePtr>& frames, uint32_t id,
+                     std::chrono::steady_clock::time_point captureTime,
+                     bool keepAlive, std::chrono::steady_clock::time_point now);
+
+    /* Returns the capture time set for the image being served, or 'now' if
+     * none was set
+     */
+    std::chrono::steady_clock::time_point getCaptureTime(
+        std::chrono::steady_clock::time_point now) const;
+
+    /* Returns the qualities chosen by the rate controllers of the stream's
+     * clients which may be sent a frame now. If 'targetsOnly' is true, only
+     * record and WebSocket clients are considered. The client socket mutex
+     * must be held.
+     */
+    std::vector<int> getReadyQualities(
+        const std::string& stream, std::chrono::steady_clock::time_point now,
+        bool targetsOnly = false);
+
+    /* Encodes the image at the given quality, or returns nullptr on failure.
+     * The caller sets the frame's ID and capture time.
+     */
+    std::shared_ptr<Frame> encodeFrame(const uint8_t* image, unsigned int width,
+                                       unsigned int height,
+                                       unsigned int channels, int quality);
+
+    /* Sends the frame to the multicast group. The client socket mutex must be
+     * held.
+     */
+    void sendMulticast(const FramePtr& frame,
+                       std::chrono::steady_clock::time_point now);
+
+    /* Sends the frame's multipart header, JPEG, and trailing CRLF with gather
+     * writes straight from the shared frame. Returns false on error.
+     */
+    bool sendFrame(Client& client, const FramePtr& frame);
+
+    /* Queues the frame and target record as WebSocket messages and sends as
+     * much as the socket takes without blocking. The frame is dropped if the
+     * previous one is still queued. Returns false on error.
+     */
+    bool sendWebSocketFrame(Client& client, const FramePtr& frame);
+
+    /* Queues a FrameRecord header, the target record, and the frame's JPEG
+     * and sends as much as the socket takes without blocking. The frame is
+     * dropped if the previous one is still queued. Returns false on error.
+     */
+    bool sendRecordFrame(Client& client, const FramePtr& frame);
+
+    /* Sends queued data until the socket would block. Returns false on
+     * error.
+     */
+    bool flushQueue(Client& client);
+
+    // Releases frames whose zero-copy sends the kernel has completed
+    void reapZeroCopy(Client& client);
+
+    /* Closes the client's socket and removes it from the list of clients.
+     * Returns the iterator following the removed client.
+     */
+    std::list<Client>::iterator removeClient(std::list<Client>::iterator i);
+
+    // Returns the value of a numeric query parameter, or 0 if it's missing
+    static double getQueryValue(const std::string& query,
+                                const std::string& key);
+
+    // Returns the multipart header which precedes a JPEG of the given size
+    static std::string makePartHeader(size_t jpegSize);
 
-    struct jpeg_compress_struct m_cinfo;
-    struct jpeg_error_mgr m_jerr;
-    JSAMPROW m_row_pointer;  // pointer to start of scanline (row of image)
+    /* Returns a socket listening on the given port, or INVALID_SOCKET on
+     * failure
+     */
+    static mjpeg_socket_t openListener(uint16_t port);
 
-    uint8_t* m_serveImg = nullptr;
-    unsigned long int m_serveLen = 0;  // NOLINT
+    // Returns false if the data couldn't be sent in its entirety
+    static bool sendAll(mjpeg_socket_t sd, const char* data, size_t length);
 };
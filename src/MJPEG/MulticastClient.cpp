@@ -0,0 +1,283 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#include "MulticastClient.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <system_error>
+
+#include <QImage>
+
+#include "../Metrics.hpp"
+#include "mjpeg_sck_selector.hpp"
+
+constexpr int32_t MulticastClient::k_lateFrames;
+
+MulticastClient::MulticastClient(const std::string& group, uint16_t port,
+                                 const std::string& interfaceAddr)
+    : m_group(group), m_port(port), m_interfaceAddr(interfaceAddr) {
+    mjpeg_socket_t pipefd[2];
+
+    /* Create a pipe that, when written to, causes any operation in the
+     * receive thread currently blocking to be cancelled.
+     */
+    if (mjpeg_pipe(pipefd) != 0) {
+        throw std::system_error();
+    }
+    m_cancelfdr = pipefd[0];
+    m_cancelfdw = pipefd[1];
+}
+
+MulticastClient::~MulticastClient() {
+    stop();
+
+    mjpeg_sck_close(m_cancelfdr);
+    mjpeg_sck_close(m_cancelfdw);
+}
+
+void MulticastClient::start() {
+    if (!isStreaming()) {  // if stream is closed, reopen it
+        // Join previous thread before making a new one
+        if (m_recvThread.joinable()) {
+            m_recvThread.join();
+        }
+
+        // Mark the thread as running
+        m_stopReceive = false;
+
+        m_recvThread = std::thread(&MulticastClient::recvFunc, this);
+    }
+}
+
+void MulticastClient::stop() {
+    if (isStreaming()) {
+        m_stopReceive = true;
+
+        // Cancel any currently blocking operations
+        send(m_cancelfdw, "U", 1, 0);
+    }
+
+    // Close the receive thread
+    if (m_recvThread.joinable()) {
+        m_recvThread.join();
+    }
+}
+
+bool MulticastClient::isStreaming() const { return !m_stopReceive; }
+
+void MulticastClient::saveCurrentImage(const std::string& fileName) {
+    std::lock_guard<std::mutex> lock(m_imageMutex);
+
+    QImage tmp(&m_pxlBuf[0], m_imgWidth, m_imgHeight,
+               m_imgChannels == 1 ? QImage::Format_Grayscale8
+                                  : QImage::Format_RGB888);
+    if (!tmp.save(fileName.c_str())) {
+        std::cout << "MulticastClient: failed to save image to '" << fileName
+                  << "'\n";
+    }
+}
+
+uint8_t* MulticastClient::getCurrentImage() {
+    std::lock_guard<std::mutex> imageLock(m_imageMutex);
+    std::lock_guard<std::mutex> extLock(m_extMutex);
+
+    m_extWidth = m_imgWidth;
+    m_extHeight = m_imgHeight;
+    m_extChannels = m_imgChannels;
+    m_extBuf = m_pxlBuf;
+
+    return &m_extBuf[0];
+}
+
+unsigned int MulticastClient::getCurrentWidth() const {
+    std::lock_guard<std::mutex> lock(m_extMutex);
+    return m_extWidth;
+}
+
+unsigned int MulticastClient::getCurrentHeight() const {
+    std::lock_guard<std::mutex> lock(m_extMutex);
+    return m_extHeight;
+}
+
+unsigned int MulticastClient::getCurrentChannels() const {
+    std::lock_guard<std::mutex> lock(m_extMutex);
+    return m_extChannels;
+}
+
+mjpeg_socket_t MulticastClient::joinGroup() {
+    mjpeg_socket_t sd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (!mjpeg_sck_valid(sd)) {
+        return INVALID_SOCKET;
+    }
+
+    // Let other receivers on this host join the same group
+    int yes = 1;
+    setsockopt(sd, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<char*>(&yes),
+               sizeof(yes));
+
+    // Make room for every fragment of a few frames arriving in a burst
+    int bufSize = 1 << 20;
+    setsockopt(sd, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<char*>(&bufSize),
+               sizeof(bufSize));
+
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(m_port);
+
+    if (bind(sd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1) {
+        mjpeg_sck_close(sd);
+        return INVALID_SOCKET;
+    }
+
+    ip_mreq mreq;
+    mreq.imr_multiaddr.s_addr = inet_addr(m_group.c_str());
+    mreq.imr_interface.s_addr = m_interfaceAddr.empty()
+                                    ? htonl(INADDR_ANY)
+                                    : inet_addr(m_interfaceAddr.c_str());
+    if (setsockopt(sd, IPPROTO_IP, IP_ADD_MEMBERSHIP,
+                   reinterpret_cast<char*>(&mreq), sizeof(mreq)) == -1) {
+        mjpeg_sck_close(sd);
+        return INVALID_SOCKET;
+    }
+
+    return sd;
+}
+
+bool MulticastClient::addFragment(const uint8_t* datagram, size_t length) {
+    MulticastPacket packet;
+    if (!packet.unpack(datagram, length)) {
+        return false;
+    }
+
+    if (!m_frameInProgress || packet.frameId != m_frameId) {
+        /* Ignore late fragments of frames which were already completed or
+         * given up on, which would otherwise start reassembling them again
+         */
+        int32_t age = static_cast<int32_t>(m_frameId - packet.frameId);
+        if ((m_frameInProgress || m_frameCompleted) && age >= 0 &&
+            age <= k_lateFrames) {
+            return false;
+        }
+
+        // A newer frame has started, so the current one can't be completed
+        if (m_frameInProgress) {
+            Metrics::drop(Metrics::DropReason::incompleteFrame);
+        }
+
+        m_frameId = packet.frameId;
+        m_frameInProgress = true;
+        m_frameCompleted = false;
+        m_frame.resize(packet.frameSize);
+        m_received.assign(packet.count, false);
+        m_receivedCount = 0;
+    }
+
+    // Ignore duplicates and fragments which disagree about the frame's size
+    if (packet.frameSize != m_frame.size() ||
+        packet.count != m_received.size() || m_received[packet.index]) {
+        return false;
+    }
+
+    std::memcpy(&m_frame[packet.index * MulticastPacket::k_maxPayload],
+                datagram + MulticastPacket::k_headerSize,
+                packet.payloadSize());
+    m_received[packet.index] = true;
+    m_receivedCount++;
+
+    if (m_receivedCount == m_received.size()) {
+        m_frameInProgress = false;
+        m_frameCompleted = true;
+        return true;
+    }
+
+    return false;
+}
+
+void MulticastClient::recvFunc() {
+    ClientBase::callStart();
+
+    m_sd = joinGroup();
+    if (!mjpeg_sck_valid(m_sd)) {
+        std::cerr << "MulticastClient: failed to join group " << m_group
+                  << ":" << m_port << "\n";
+        m_stopReceive = true;
+        ClientBase::callStop();
+
+        return;
+    }
+
+    m_frameInProgress = false;
+    m_frameCompleted = false;
+
+    // Largest datagram MjpegServer sends
+    uint8_t datagram[MulticastPacket::k_headerSize +
+                     MulticastPacket::k_maxPayload];
+
+    mjpeg_sck_selector selector;
+    selector.addSocket(m_sd,
+                       mjpeg_sck_selector::read | mjpeg_sck_selector::except);
+    selector.addSocket(m_cancelfdr,
+                       mjpeg_sck_selector::read | mjpeg_sck_selector::except);
+
+    while (!m_stopReceive) {
+        if (selector.select(nullptr) == -1 ||
+            selector.isReady(m_cancelfdr, mjpeg_sck_selector::except) ||
+            selector.isReady(m_sd, mjpeg_sck_selector::except)) {
+            break;
+        }
+
+        // Consume the cancellation so the next start() isn't cancelled too
+        if (selector.isReady(m_cancelfdr, mjpeg_sck_selector::read)) {
+            char cancel[2];
+            recv(m_cancelfdr, cancel, 2, 0);
+            break;
+        }
+
+        int bytesRead = recv(m_sd, reinterpret_cast<char*>(datagram),
+                             sizeof(datagram), 0);
+        if (bytesRead < 0) {
+            std::cerr << "recv(2) failed\n";
+            break;
+        }
+
+        if (!addFragment(datagram, bytesRead)) {
+            continue;
+        }
+        m_receiveTime = std::chrono::steady_clock::now();
+        Metrics::add(Metrics::Counter::framesReceived);
+
+        // A repeated JPEG would decode to the image already in m_pxlBuf
+        if (ClientBase::isDuplicate(&m_frame[0], m_frame.size())) {
+            ClientBase::callRepeatedImage();
+            continue;
+        }
+
+        // Load the image received (converts from JPEG to pixel array)
+        auto startTime = std::chrono::steady_clock::now();
+        bool decompressed = false;
+        {
+            std::lock_guard<std::mutex> lock(m_imageMutex);
+            decompressed =
+                jpeg_load_from_memory(&m_frame[0], m_frame.size(), m_pxlBuf);
+        }
+
+        if (decompressed) {
+            Metrics::addLatency(Metrics::Stage::decode,
+                                std::chrono::steady_clock::now() - startTime);
+            Metrics::add(Metrics::Counter::framesDecoded);
+            ClientBase::callNewImage(&m_pxlBuf[0], m_pxlBuf.size());
+        } else {
+            Metrics::drop(Metrics::DropReason::decodeFailed);
+        }
+    }
+
+    // The loop has exited. We should now clean up and exit the thread.
+    mjpeg_sck_close(m_sd);
+
+    m_stopReceive = true;
+
+    ClientBase::callStop();
+}
@@ -0,0 +1,118 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ClientBase.hpp"
+#include "MulticastPacket.hpp"
+#include "mjpeg_sck.hpp"
+
+/**
+ * Receives frames sent to a UDP multicast group by MjpegServer and reassembles
+ * them from their fragments
+ *
+ * Only one frame is reassembled at a time. If a fragment of a newer frame
+ * arrives before the current one is complete, the current one is dropped.
+ * Fragments of frames at or before the last one completed are ignored.
+ */
+class MulticastClient : public ClientBase {
+public:
+    /* 'interfaceAddr' is the IPv4 address of the local interface on which to
+     * join the group. An empty string lets the system choose.
+     */
+    MulticastClient(const std::string& group, uint16_t port,
+                    const std::string& interfaceAddr);
+    virtual ~MulticastClient();
+
+    // Join the multicast group
+    void start();
+
+    // Leave the multicast group
+    void stop();
+
+    // Returns true if streaming is on
+    bool isStreaming() const;
+
+    // Saves most recently received image to a file
+    void saveCurrentImage(const std::string& fileName);
+
+    /* Copies the most recently received image into a secondary internal buffer
+     * and returns it to the user. After a call to this function, the new size
+     * should be retrieved since it may have changed. Do NOT access the buffer
+     * pointer returned while this function is executing.
+     */
+    uint8_t* getCurrentImage();
+
+    // Returns size and channels of image currently in secondary buffer
+    unsigned int getCurrentWidth() const;
+    unsigned int getCurrentHeight() const;
+    unsigned int getCurrentChannels() const;
+
+private:
+    /* Fragments of frames up to this many frames older than the current one
+     * are late. Older ones mean the sender restarted its frame IDs.
+     */
+    static constexpr int32_t k_lateFrames = 64;
+
+    std::string m_group;
+    uint16_t m_port;
+    std::string m_interfaceAddr;
+
+    // Stores image before displaying it on the screen
+    std::vector<uint8_t> m_pxlBuf;
+    mutable std::mutex m_imageMutex;
+
+    /* Stores copy of image for use by external programs. It only updates when
+     * getCurrentImage() is called.
+     */
+    std::vector<uint8_t> m_extBuf;
+    unsigned int m_extWidth = 0;
+    unsigned int m_extHeight = 0;
+    unsigned int m_extChannels = 0;
+    mutable std::mutex m_extMutex;
+
+    /* ===== Reassembly state ===== */
+    // Frame being reassembled. Its buffer is reused between frames.
+    std::vector<uint8_t> m_frame;
+    uint32_t m_frameId = 0;
+    bool m_frameInProgress = false;
+
+    // True if the frame with ID m_frameId was completed
+    bool m_frameCompleted = false;
+
+    // Which fragments of the current frame have arrived
+    std::vector<bool> m_received;
+    unsigned int m_receivedCount = 0;
+    /* ============================ */
+
+    std::thread m_recvThread;
+
+    /* If false:
+     *     Lets receive thread run
+     * If true:
+     *     Closes receive thread
+     */
+    std::atomic<bool> m_stopReceive{true};
+
+    mjpeg_socket_t m_cancelfdr = 0;
+    mjpeg_socket_t m_cancelfdw = 0;
+    mjpeg_socket_t m_sd = INVALID_SOCKET;
+
+    // Used by m_recvThread
+    void recvFunc();
+
+    // Opens a socket bound to the group's port and joins the group
+    mjpeg_socket_t joinGroup();
+
+    /* Adds a datagram's fragment to the frame being reassembled. Returns true
+     * if it completed the frame.
+     */
+    bool addFragment(const uint8_t* datagram, size_t length);
+};
@@ -0,0 +1,54 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#include "MulticastPacket.hpp"
+
+#include <algorithm>
+
+constexpr uint32_t MulticastPacket::k_magic;
+constexpr size_t MulticastPacket::k_headerSize;
+constexpr size_t MulticastPacket::k_maxPayload;
+
+namespace {
+
+void write32(uint8_t* buf, uint32_t value) {
+    buf[0] = value >> 24;
+    buf[1] = value >> 16;
+    buf[2] = value >> 8;
+    buf[3] = value;
+}
+
+uint32_t read32(const uint8_t* buf) {
+    return (static_cast<uint32_t>(buf[0]) << 24) | (buf[1] << 16) |
+           (buf[2] << 8) | buf[3];
+}
+
+}  // namespace
+
+void MulticastPacket::pack(uint8_t* buf) const {
+    write32(buf, k_magic);
+    write32(buf + 4, frameId);
+    write32(buf + 8, frameSize);
+    buf[12] = index >> 8;
+    buf[13] = index;
+    buf[14] = count >> 8;
+    buf[15] = count;
+}
+
+bool MulticastPacket::unpack(const uint8_t* buf, size_t length) {
+    if (length < k_headerSize || read32(buf) != k_magic) {
+        return false;
+    }
+
+    frameId = read32(buf + 4);
+    frameSize = read32(buf + 8);
+    index = (buf[12] << 8) | buf[13];
+    count = (buf[14] << 8) | buf[15];
+
+    return frameSize > 0 &&
+           count == (frameSize + k_maxPayload - 1) / k_maxPayload &&
+           index < count && length - k_headerSize == payloadSize();
+}
+
+size_t MulticastPacket::payloadSize() const {
+    return std::min<size_t>(k_maxPayload, frameSize - index * k_maxPayload);
+}
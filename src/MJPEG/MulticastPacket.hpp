@@ -0,0 +1,42 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Header which precedes each fragment of a frame sent to a multicast group
+ *
+ * A frame is split into fragments of k_maxPayload bytes (the last may be
+ * shorter), each sent in its own datagram. Fragment 'index' holds the bytes
+ * starting at index * k_maxPayload. The header is serialized in network byte
+ * order.
+ */
+struct MulticastPacket {
+    static constexpr uint32_t k_magic = 0x494E534D;  // "INSM"
+    static constexpr size_t k_headerSize = 16;
+
+    // Keeps datagrams within a 1500 byte Ethernet MTU after IP/UDP headers
+    static constexpr size_t k_maxPayload = 1400;
+
+    // Incremented for each frame sent
+    uint32_t frameId = 0;
+
+    // Size in bytes of the whole frame
+    uint32_t frameSize = 0;
+
+    uint16_t index = 0;
+    uint16_t count = 0;
+
+    // Writes the header into the first k_headerSize bytes of 'buf'
+    void pack(uint8_t* buf) const;
+
+    /* Reads the header from a datagram. Returns false if the datagram isn't a
+     * fragment or its header is inconsistent with its length.
+     */
+    bool unpack(const uint8_t* buf, size_t length);
+
+    // Returns the number of payload bytes the fragment should carry
+    size_t payloadSize() const;
+};
@@ -0,0 +1,97 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#include "MulticastSender.hpp"
+
+#include <cstring>
+#include <iostream>
+
+#include "../Metrics.hpp"
+#include "MulticastPacket.hpp"
+
+MulticastSender::MulticastSender(const std::string& group, uint16_t port,
+                                 const std::string& interfaceAddr) {
+    m_address = group + ":" + std::to_string(port);
+
+    m_socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (!mjpeg_sck_valid(m_socket)) {
+        std::cout << "MulticastSender: failed to create socket\n";
+        return;
+    }
+
+    // Deliver to receivers on this host too so it can be tested over loopback
+    unsigned char loop = 1;
+    setsockopt(m_socket, IPPROTO_IP, IP_MULTICAST_LOOP,
+               reinterpret_cast<char*>(&loop), sizeof(loop));
+
+    if (!interfaceAddr.empty()) {
+        in_addr iface;
+        iface.s_addr = inet_addr(interfaceAddr.c_str());
+        if (setsockopt(m_socket, IPPROTO_IP, IP_MULTICAST_IF,
+                       reinterpret_cast<char*>(&iface), sizeof(iface)) == -1) {
+            std::cout << "MulticastSender: failed to select interface "
+                      << interfaceAddr << "\n";
+        }
+    }
+
+    // Connecting lets every fragment be sent without an address
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr(group.c_str());
+    addr.sin_port = htons(port);
+
+    if (connect(m_socket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) ==
+        -1) {
+        std::cout << "MulticastSender: failed to set group " << m_address
+                  << "\n";
+        mjpeg_sck_close(m_socket);
+        m_socket = INVALID_SOCKET;
+        return;
+    }
+
+    std::cout << "Sending frames to multicast group " << m_address << "\n";
+}
+
+MulticastSender::~MulticastSender() {
+    if (mjpeg_sck_valid(m_socket)) {
+        mjpeg_sck_close(m_socket);
+    }
+}
+
+bool MulticastSender::isOpen() const { return mjpeg_sck_valid(m_socket); }
+
+bool MulticastSender::send(const std::vector<uint8_t>& frame) {
+    // The fragment count must fit in 16 bits
+    if (!isOpen() || frame.empty() ||
+        frame.size() > 0xFFFF * MulticastPacket::k_maxPayload) {
+        return false;
+    }
+
+    MulticastPacket packet;
+    packet.frameId = m_frameId++;
+    packet.frameSize = frame.size();
+    packet.count = (frame.size() + MulticastPacket::k_maxPayload - 1) /
+                   MulticastPacket::k_maxPayload;
+
+    uint8_t header[MulticastPacket::k_headerSize];
+
+    bool sentAll = true;
+    for (packet.index = 0; packet.index < packet.count; packet.index++) {
+        packet.pack(header);
+
+        // The payload is sent straight from the frame rather than a copy
+        mjpeg_iovec iov[2] = {
+            {header, sizeof(header)},
+            {frame.data() + packet.index * MulticastPacket::k_maxPayload,
+             packet.payloadSize()}};
+        if (mjpeg_sck_sendv(m_socket, iov, 2, 0) == -1) {
+            sentAll = false;
+        } else {
+            Metrics::add(Metrics::Counter::multicastPacketsSent);
+        }
+    }
+
+    return sentAll;
+}
+
+const std::string& MulticastSender::getAddress() const { return m_address; }
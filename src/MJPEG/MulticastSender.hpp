@@ -0,0 +1,46 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "mjpeg_sck.hpp"
+
+/**
+ * Sends frames to a UDP multicast group
+ *
+ * Each frame is sent once no matter how many receivers have joined the group,
+ * so the sender's bandwidth doesn't grow with the number of viewers. Frames
+ * are fragmented as described by MulticastPacket.
+ */
+class MulticastSender {
+public:
+    /* 'interfaceAddr' is the IPv4 address of the local interface to send on.
+     * An empty string uses the system's default multicast route.
+     */
+    MulticastSender(const std::string& group, uint16_t port,
+                    const std::string& interfaceAddr);
+    virtual ~MulticastSender();
+
+    MulticastSender(const MulticastSender&) = delete;
+    MulticastSender& operator=(const MulticastSender&) = delete;
+
+    // Returns true if the socket was set up successfully
+    bool isOpen() const;
+
+    /* Sends the frame as a sequence of fragments. Returns false if any of them
+     * couldn't be sent.
+     */
+    bool send(const std::vector<uint8_t>& frame);
+
+    // Returns the group's address as "ip:port"
+    const std::string& getAddress() const;
+
+private:
+    mjpeg_socket_t m_socket = INVALID_SOCKET;
+    std::string m_address;
+    uint32_t m_frameId = 0;
+};
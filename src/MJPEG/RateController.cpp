@@ -0,0 +1,118 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#include "RateController.hpp"
+
+#include <algorithm>
+
+constexpr int RateController::k_minQuality;
+constexpr int RateController::k_qualityStep;
+constexpr double RateController::k_burstTime;
+constexpr std::chrono::seconds RateController::k_measureInterval;
+constexpr double RateController::k_raiseThreshold;
+
+using namespace std::chrono;
+
+void RateController::setMaxBitrate(double bitsPerSecond) {
+    m_maxBitrate = std::max(0.0, bitsPerSecond);
+    m_tokens = m_maxBitrate / 8.0 * k_burstTime;
+    m_quality = m_maxQuality;
+}
+
+double RateController::getMaxBitrate() const { return m_maxBitrate; }
+
+void RateController::setMaxFrameRate(double framesPerSecond) {
+    m_maxFrameRate = std::max(0.0, framesPerSecond);
+}
+
+double RateController::getMaxFrameRate() const { return m_maxFrameRate; }
+
+void RateController::setMaxQuality(int quality) {
+    // Round down to a multiple of the quality step
+    quality -= quality % k_qualityStep;
+    m_maxQuality = std::max(k_minQuality, std::min(quality, 100));
+    m_quality = m_maxQuality;
+}
+
+int RateController::getQuality() const { return m_quality; }
+
+bool RateController::isReady(TimePoint now) {
+    if (m_maxFrameRate > 0.0) {
+        /* Accept frames arriving up to a quarter of an interval early so
+         * jitter in a source running at the capped rate doesn't halve it
+         */
+        auto interval = duration_cast<steady_clock::duration>(
+            duration<double>(1.0 / m_maxFrameRate));
+        if (now < m_nextFrameTime - interval / 4) {
+            return false;
+        }
+    }
+
+    if (m_maxBitrate > 0.0) {
+        // Refill the bucket for the time elapsed since the last check
+        if (m_refillTime != TimePoint()) {
+            double elapsed = duration<double>(now - m_refillTime).count();
+            m_tokens = std::min(m_tokens + elapsed * m_maxBitrate / 8.0,
+                                m_maxBitrate / 8.0 * k_burstTime);
+        }
+        m_refillTime = now;
+
+        if (m_tokens < 0.0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void RateController::consume(size_t bytes, TimePoint now) {
+    m_tokens -= bytes;
+
+    if (m_maxFrameRate > 0.0) {
+        auto interval = duration_cast<steady_clock::duration>(
+            duration<double>(1.0 / m_maxFrameRate));
+
+        // Don't let a stall build up a burst of frames to catch up on
+        m_nextFrameTime = std::max(m_nextFrameTime + interval, now);
+    }
+
+    if (now - m_intervalStart >= k_measureInterval) {
+        if (m_intervalStart != TimePoint()) {
+            m_bitrate = m_intervalBytes * 8.0 /
+                        duration<double>(now - m_intervalStart).count();
+        }
+        m_intervalStart = now;
+        m_intervalBytes = 0;
+    }
+    m_intervalBytes += bytes;
+}
+
+void RateController::adjustQuality(size_t jpegSize, double sourceFrameRate) {
+    if (m_maxBitrate == 0.0) {
+        return;
+    }
+
+    double frameRate = sourceFrameRate;
+    if (m_maxFrameRate > 0.0) {
+        frameRate = std::min(frameRate, m_maxFrameRate);
+    }
+    if (frameRate <= 0.0) {
+        return;
+    }
+
+    double budget = m_maxBitrate / 8.0 / frameRate;
+    if (jpegSize > budget && m_quality > k_minQuality) {
+        m_quality -= k_qualityStep;
+    } else if (jpegSize < budget * k_raiseThreshold &&
+               m_quality < m_maxQuality) {
+        m_quality += k_qualityStep;
+    }
+}
+
+double RateController::getBitrate(TimePoint now) const {
+    // If nothing has been sent for a while, report the rate since then
+    auto elapsed = now - m_intervalStart;
+    if (m_intervalStart != TimePoint() && elapsed >= 2 * k_measureInterval) {
+        return m_intervalBytes * 8.0 / duration<double>(elapsed).count();
+    }
+    return m_bitrate;
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <stddef.h>
+
+#include <chrono>
+
+/**
+ * Limits the bandwidth and frame rate of one client's stream
+ *
+ * A token bucket holding a quarter second's worth of bytes caps the bitrate.
+ * Frames are skipped while the bucket is empty. Each frame sent is compared
+ * against the per-frame budget implied by the bitrate and the source's frame
+ * rate, and the JPEG quality is stepped down or up to bring the frame size
+ * back within it. Qualities are multiples of 10 so clients with similar
+ * limits share encoded frames.
+ */
+class RateController {
+public:
+    typedef std::chrono::steady_clock::time_point TimePoint;
+
+    static constexpr int k_minQuality = 20;
+    static constexpr int k_qualityStep = 10;
+
+    // Sets the bitrate limit in bits per second. 0 removes the limit.
+    void setMaxBitrate(double bitsPerSecond);
+    double getMaxBitrate() const;
+
+    // Sets the frame rate limit in frames per second. 0 removes the limit.
+    void setMaxFrameRate(double framesPerSecond);
+    double getMaxFrameRate() const;
+
+    /* Sets the quality used when bandwidth isn't a constraint. The current
+     * quality is reset to it.
+     */
+    void setMaxQuality(int quality);
+
+    // Returns the JPEG quality the next frame should be encoded with
+    int getQuality() const;
+
+    // Returns true if a frame may be sent at the given time
+    bool isReady(TimePoint now);
+
+    // Records that 'bytes' bytes were sent at the given time
+    void consume(size_t bytes, TimePoint now);
+
+    /* Adjusts the quality based on the size of the last JPEG sent and the
+     * rate at which the source produces frames
+     */
+    void adjustQuality(size_t jpegSize, double sourceFrameRate);
+
+    // Returns the bitrate actually achieved in bits per second
+    double getBitrate(TimePoint now) const;
+
+private:
+    // How many seconds of data the token bucket holds
+    static constexpr double k_burstTime = 0.25;
+
+    // Interval over which the achieved bitrate is measured
+    static constexpr std::chrono::seconds k_measureInterval{1};
+
+    /* The quality is only raised when the last frame used less than this
+     * fraction of its budget so it doesn't oscillate between two steps
+     */
+    static constexpr double k_raiseThreshold = 0.6;
+
+    double m_maxBitrate = 0.0;
+    double m_maxFrameRate = 0.0;
+    int m_maxQuality = 100;
+    int m_quality = 100;
+
+    // Bytes available to send. It goes negative when a frame overdraws it.
+    double m_tokens = 0.0;
+    TimePoint m_refillTime;
+
+    // Earliest time at which the next frame is due under the frame rate cap
+    TimePoint m_nextFrameTime;
+
+    // Bytes sent since the start of the current measurement interval
+    size_t m_intervalBytes = 0;
+    TimePoint m_intervalStart;
+    double m_bitrate = 0.0;
+};
@@ -0,0 +1,209 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#include "RecordClient.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <system_error>
+
+#include <QImage>
+
+#include "../Metrics.hpp"
+
+constexpr size_t RecordClient::k_initialJpegSize;
+
+RecordClient::RecordClient(const std::string& hostName, uint16_t port)
+    : m_hostName(hostName), m_port(port) {
+    mjpeg_socket_t pipefd[2];
+
+    /* Create a pipe that, when written to, causes any operation in the
+     * receive thread currently blocking to be cancelled.
+     */
+    if (mjpeg_pipe(pipefd) != 0) {
+        throw std::system_error();
+    }
+    m_cancelfdr = pipefd[0];
+    m_cancelfdw = pipefd[1];
+
+    m_jpeg.resize(k_initialJpegSize);
+}
+
+RecordClient::~RecordClient() {
+    stop();
+
+    mjpeg_sck_close(m_cancelfdr);
+    mjpeg_sck_close(m_cancelfdw);
+}
+
+void RecordClient::start() {
+    if (!isStreaming()) {  // if stream is closed, reopen it
+        // Join previous thread before making a new one
+        if (m_recvThread.joinable()) {
+            m_recvThread.join();
+        }
+
+        // Mark the thread as running
+        m_stopReceive = false;
+
+        m_recvThread = std::thread(&RecordClient::recvFunc, this);
+    }
+}
+
+void RecordClient::stop() {
+    if (isStreaming()) {
+        m_stopReceive = true;
+
+        // Cancel any currently blocking operations
+        send(m_cancelfdw, "U", 1, 0);
+    }
+
+    // Close the receive thread
+    if (m_recvThread.joinable()) {
+        m_recvThread.join();
+    }
+}
+
+bool RecordClient::isStreaming() const { return !m_stopReceive; }
+
+void RecordClient::saveCurrentImage(const std::string& fileName) {
+    std::lock_guard<std::mutex> lock(m_imageMutex);
+
+    QImage tmp(&m_pxlBuf[0], m_imgWidth, m_imgHeight,
+               m_imgChannels == 1 ? QImage::Format_Grayscale8
+                                  : QImage::Format_RGB888);
+    if (!tmp.save(fileName.c_str())) {
+        std::cout << "RecordClient: failed to save image to '" << fileName
+                  << "'\n";
+    }
+}
+
+uint8_t* RecordClient::getCurrentImage() {
+    std::lock_guard<std::mutex> imageLock(m_imageMutex);
+    std::lock_guard<std::mutex> extLock(m_extMutex);
+
+    m_extWidth = m_imgWidth;
+    m_extHeight = m_imgHeight;
+    m_extChannels = m_imgChannels;
+    m_extBuf = m_pxlBuf;
+    m_extRecord = m_record;
+    m_extTargets = m_targets;
+
+    return &m_extBuf[0];
+}
+
+unsigned int RecordClient::getCurrentWidth() const {
+    std::lock_guard<std::mutex> lock(m_extMutex);
+    return m_extWidth;
+}
+
+unsigned int RecordClient::getCurrentHeight() const {
+    std::lock_guard<std::mutex> lock(m_extMutex);
+    return m_extHeight;
+}
+
+unsigned int RecordClient::getCurrentChannels() const {
+    std::lock_guard<std::mutex> lock(m_extMutex);
+    return m_extChannels;
+}
+
+uint32_t RecordClient::getCurrentFrameId() const {
+    std::lock_guard<std::mutex> lock(m_extMutex);
+    return m_extRecord.frameId;
+}
+
+uint64_t RecordClient::getCurrentTimestamp() const {
+    std::lock_guard<std::mutex> lock(m_extMutex);
+    return m_extRecord.timestamp;
+}
+
+void RecordClient::getCurrentTargets(std::vector<uint8_t>& record) const {
+    std::lock_guard<std::mutex> lock(m_extMutex);
+    record = m_extTargets;
+}
+
+bool RecordClient::readRecord(FrameRecord& record) {
+    if (mjpeg_sck_recv(m_sd, m_header, sizeof(m_header), m_cancelfdr) !=
+            static_cast<int>(sizeof(m_header)) ||
+        !record.unpack(m_header)) {
+        return false;
+    }
+
+    // The buffers only grow, so records no larger than earlier ones reuse them
+    if (m_recvTargets.size() < record.targetsSize) {
+        m_recvTargets.resize(record.targetsSize);
+    }
+    if (m_jpeg.size() < record.jpegSize) {
+        m_jpeg.resize(record.jpegSize);
+    }
+
+    if (record.targetsSize > 0 &&
+        mjpeg_sck_recv(m_sd, &m_recvTargets[0], record.targetsSize,
+                       m_cancelfdr) != static_cast<int>(record.targetsSize)) {
+        return false;
+    }
+
+    return mjpeg_sck_recv(m_sd, &m_jpeg[0], record.jpegSize, m_cancelfdr) ==
+           static_cast<int>(record.jpegSize);
+}
+
+void RecordClient::recvFunc() {
+    ClientBase::callStart();
+
+    // Connect to the remote host.
+    m_sd = mjpeg_sck_connect(m_hostName.c_str(), m_port, m_cancelfdr);
+    if (!mjpeg_sck_valid(m_sd)) {
+        std::cerr << "RecordClient: connection failed\n";
+        m_stopReceive = true;
+        ClientBase::callStop();
+
+        return;
+    }
+
+    FrameRecord record;
+    while (!m_stopReceive) {
+        if (!readRecord(record)) {
+            std::cerr << "RecordClient: recv(2) failed\n";
+            break;
+        }
+
+        // The record carries the capture time, which predates its arrival
+        auto age = std::chrono::system_clock::now() -
+                   std::chrono::system_clock::time_point(
+                       std::chrono::microseconds(record.timestamp));
+        m_receiveTime =
+            std::chrono::steady_clock::now() -
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                age);
+        Metrics::add(Metrics::Counter::framesReceived);
+
+        // Load the image received (converts from JPEG to pixel array)
+        auto startTime = std::chrono::steady_clock::now();
+        bool decompressed = false;
+        {
+            std::lock_guard<std::mutex> lock(m_imageMutex);
+            decompressed =
+                jpeg_load_from_memory(&m_jpeg[0], record.jpegSize, m_pxlBuf);
+            if (decompressed) {
+                m_record = record;
+                m_targets.assign(m_recvTargets.begin(),
+                                 m_recvTargets.begin() + record.targetsSize);
+            }
+        }
+
+        if (decompressed) {
+            Metrics::addLatency(Metrics::Stage::decode,
+                                std::chrono::steady_clock::now() - startTime);
+            Metrics::add(Metrics::Counter::framesDecoded);
+            ClientBase::callNewImage(&m_pxlBuf[0], m_pxlBuf.size());
+        } else {
+            Metrics::drop(Metrics::DropReason::decodeFailed);
+        }
+    }
+
+    // The loop has exited. We should now clean up and exit the thread.
+    mjpeg_sck_close(m_sd);
+
+    m_stopReceive = true;
+
+    ClientBase::callStop();
+}
@@ -0,0 +1,118 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ClientBase.hpp"
+#include "FrameRecord.hpp"
+#include "mjpeg_sck.hpp"
+
+/**
+ * Receives the record stream served by MjpegServer::enableRecordStream()
+ *
+ * Records are read straight into buffers which are reused between frames and
+ * only grow when a larger record arrives, so no memory is allocated per frame
+ * once the stream settles. Along with the image, the frame ID, capture time,
+ * and target record of the image returned by getCurrentImage() are available.
+ */
+class RecordClient : public ClientBase {
+public:
+    RecordClient(const std::string& hostName, uint16_t port);
+    virtual ~RecordClient();
+
+    // Connect to the record stream
+    void start();
+
+    // Stop receiving the record stream
+    void stop();
+
+    // Returns true if streaming is on
+    bool isStreaming() const;
+
+    // Saves most recently received image to a file
+    void saveCurrentImage(const std::string& fileName);
+
+    /* Copies the most recently received image into a secondary internal buffer
+     * and returns it to the user. After a call to this function, the new size
+     * should be retrieved since it may have changed. Do NOT access the buffer
+     * pointer returned while this function is executing.
+     */
+    uint8_t* getCurrentImage();
+
+    // Returns size and channels of image currently in secondary buffer
+    unsigned int getCurrentWidth() const;
+    unsigned int getCurrentHeight() const;
+    unsigned int getCurrentChannels() const;
+
+    // Returns the frame ID of the image currently in the secondary buffer
+    uint32_t getCurrentFrameId() const;
+
+    /* Returns the time at which the image currently in the secondary buffer
+     * was captured in microseconds since the Unix epoch
+     */
+    uint64_t getCurrentTimestamp() const;
+
+    /* Copies the target record sent with the image currently in the secondary
+     * buffer into 'record'. See ProcBase::getTargetRecord() for its format.
+     */
+    void getCurrentTargets(std::vector<uint8_t>& record) const;
+
+private:
+    // Initial size of the receive buffer for JPEGs
+    static constexpr size_t k_initialJpegSize = 256 * 1024;
+
+    std::string m_hostName;
+    uint16_t m_port;
+
+    // Stores image before displaying it on the screen
+    std::vector<uint8_t> m_pxlBuf;
+    FrameRecord m_record;
+    std::vector<uint8_t> m_targets;
+    mutable std::mutex m_imageMutex;
+
+    /* Stores copy of image for use by external programs. It only updates when
+     * getCurrentImage() is called.
+     */
+    std::vector<uint8_t> m_extBuf;
+    unsigned int m_extWidth = 0;
+    unsigned int m_extHeight = 0;
+    unsigned int m_extChannels = 0;
+    FrameRecord m_extRecord;
+    std::vector<uint8_t> m_extTargets;
+    mutable std::mutex m_extMutex;
+
+    /* ===== Receive buffers ===== */
+    // Only used by m_recvThread
+    uint8_t m_header[FrameRecord::k_headerSize];
+    std::vector<uint8_t> m_recvTargets;
+    std::vector<uint8_t> m_jpeg;
+    /* =========================== */
+
+    std::thread m_recvThread;
+
+    /* If false:
+     *     Lets receive thread run
+     * If true:
+     *     Closes receive thread
+     */
+    std::atomic<bool> m_stopReceive{true};
+
+    mjpeg_socket_t m_cancelfdr = 0;
+    mjpeg_socket_t m_cancelfdw = 0;
+    mjpeg_socket_t m_sd = INVALID_SOCKET;
+
+    // Used by m_recvThread
+    void recvFunc();
+
+    /* Reads the next record into the receive buffers. Returns false if the
+     * connection failed, was cancelled, or sent something other than a record.
+     */
+    bool readRecord(FrameRecord& record);
+};
@@ -0,0 +1,30 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Receives rows of an image as a decoder produces them
+ *
+ * Rows are handed over in small batches right after they're decompressed, so
+ * work done on them here reads pixels which are still in cache instead of
+ * making another pass over the whole image afterward.
+ */
+class ScanlineSink {
+public:
+    virtual ~ScanlineSink() = default;
+
+    // Called before the first row of each image
+    virtual void beginImage(unsigned int width, unsigned int height,
+                            unsigned int channels) = 0;
+
+    /* Called with 'numRows' rows starting at row 'firstRow'. Rows are
+     * 'stride' bytes apart and only valid until this function returns.
+     */
+    virtual void processRows(const uint8_t* rows, unsigned int firstRow,
+                             unsigned int numRows, unsigned int stride) = 0;
+
+    // Called after the last row of each image
+    virtual void endImage() = 0;
+};
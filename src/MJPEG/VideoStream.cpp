@@ -10,6 +10,7 @@
 #include <QMouseEvent>
 #include <QPainter>
 
+#include "../Metrics.hpp"
 #include "../Util.hpp"
 #include "ClientBase.hpp"
 
@@ -19,12 +20,14 @@ VideoStream::VideoStream(ClientBase* client, QWidget* parentWin, int width,
                          int height, WindowCallbacks* windowCallbacks,
                          std::function<void(void)> newImageCbk,
                          std::function<void(void)> startCbk,
-                         std::function<void(void)> stopCbk)
+                         std::function<void(void)> stopCbk,
+                         std::function<void(void)> repeatedImageCbk)
     : QOpenGLWidget(parentWin),
 
       m_newImageCallback(newImageCbk),
       m_startCallback(startCbk),
-      m_stopCallback(stopCbk) {
+      m_stopCallback(stopCbk),
+      m_repeatedImageCallback(repeatedImageCbk) {
     connect(this, SIGNAL(redraw()), this, SLOT(repaint()));
 
     m_client = client;
@@ -32,6 +35,7 @@ VideoStream::VideoStream(ClientBase* client, QWidget* parentWin, int width,
     m_client->setNewImageCallback(&VideoStream::newImageCallback);
     m_client->setStartCallback(&VideoStream::startCallback);
     m_client->setStopCallback(&VideoStream::stopCallback);
+    m_client->setRepeatedImageCallback(&VideoStream::repeatedImageCallback);
 
     // Initialize the WindowCallbacks pointer
     m_windowCallbacks = windowCallbacks;
@@ -71,13 +75,25 @@ void VideoStream::newImageCallback(uint8_t* buf, int bufsize) {
             m_img = m_client->getCurrentImage();
             m_imgWidth = m_client->getCurrentWidth();
             m_imgHeight = m_client->getCurrentHeight();
+            m_imgChannels = m_client->getCurrentChannels();
         }
 
         if (m_firstImage) {
             m_firstImage = false;
         }
+    } else {
+        Metrics::drop(Metrics::DropReason::displayRate);
+    }
+
+    m_imageAge = std::chrono::system_clock::now();
+}
+
+void VideoStream::repeatedImageCallback() {
+    if (m_repeatedImageCallback != nullptr) {
+        m_repeatedImageCallback();
     }
 
+    // The image shown is still current
     m_imageAge = std::chrono::system_clock::now();
 }
 
@@ -102,7 +118,33 @@ void VideoStream::stopCallback() {
 
 void VideoStream::mousePressEvent(QMouseEvent* event) {
     if (m_windowCallbacks != nullptr) {
-        m_windowCallbacks->clickEvent(event->x(), event->y());
+        int x = event->x();
+        int y = event->y();
+
+        /* Convert the click from window coordinates to image coordinates by
+         * undoing the scaling and centering done in paintGL()
+         */
+        int width;
+        int height;
+        {
+            std::lock_guard<std::mutex> lock(m_imageMutex);
+            width = m_imgWidth;
+            height = m_imgHeight;
+        }
+
+        QSize dstsize(width, height);
+        dstsize.scale(size(), Qt::KeepAspectRatio);
+        if (dstsize.width() > 0 && dstsize.height() > 0) {
+            QSize offset = size() - dstsize;
+            offset /= 2;
+            x = (x - offset.width()) * width / dstsize.width();
+            y = (y - offset.height()) * height / dstsize.height();
+        }
+
+        // Ignore clicks on the border around the image
+        if (x >= 0 && y >= 0 && x < width && y < height) {
+            m_windowCallbacks->clickEvent(x, y);
+        }
     }
 }
 
@@ -125,7 +167,9 @@ void VideoStream::paintGL() {
             // Else display the image last received
             std::lock_guard<std::mutex> lock(m_imageMutex);
 
-            QImage tmp(m_img, m_imgWidth, m_imgHeight, QImage::Format_RGB888);
+            QImage tmp(m_img, m_imgWidth, m_imgHeight,
+                       m_imgChannels == 1 ? QImage::Format_Grayscale8
+                                          : QImage::Format_RGB888);
             QSize dstsize = tmp.size();
             dstsize.scale(size(), Qt::KeepAspectRatio);
             QSize offset = size() - dstsize;
@@ -32,7 +32,8 @@ public:
                 WindowCallbacks* windowCallbacks,
                 std::function<void(void)> newImageCbk = nullptr,
                 std::function<void(void)> startCbk = nullptr,
-                std::function<void(void)> stopCbk = nullptr);
+                std::function<void(void)> stopCbk = nullptr,
+                std::function<void(void)> repeatedImageCbk = nullptr);
     virtual ~VideoStream();
 
     QSize sizeHint() const;
@@ -42,6 +43,7 @@ public:
 
 protected:
     void newImageCallback(uint8_t* buf, int bufsize);
+    void repeatedImageCallback();
     void startCallback();
     void stopCallback();
 
@@ -65,6 +67,7 @@ private:
     uint8_t* m_img = nullptr;
     unsigned int m_imgWidth = 0;
     unsigned int m_imgHeight = 0;
+    unsigned int m_imgChannels = 3;
     unsigned int m_textureWidth = 0;
     unsigned int m_textureHeight = 0;
     std::mutex m_imageMutex;
@@ -94,6 +97,7 @@ private:
     std::function<void(void)> m_newImageCallback;
     std::function<void(void)> m_startCallback;
     std::function<void(void)> m_stopCallback;
+    std::function<void(void)> m_repeatedImageCallback;
 
     // Makes sure "Waiting..." graphic is drawn after timeout
     std::thread m_updateThread;
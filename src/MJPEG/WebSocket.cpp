@@ -0,0 +1,177 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#include "WebSocket.hpp"
+
+std::string WebSocket::acceptKey(const std::string& key) {
+    // RFC 6455 section 1.3
+    return base64(sha1(key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"));
+}
+
+std::string WebSocket::frameHeader(Opcode opcode, size_t length) {
+    std::string header;
+
+    // FIN is set since messages are never fragmented
+    header += static_cast<char>(0x80 | static_cast<uint8_t>(opcode));
+
+    // Server-to-client messages are never masked
+    if (length < 126) {
+        header += static_cast<char>(length);
+    } else if (length <= 0xFFFF) {
+        header += static_cast<char>(126);
+        header += static_cast<char>(length >> 8);
+        header += static_cast<char>(length & 0xFF);
+    } else {
+        header += static_cast<char>(127);
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            header += static_cast<char>(static_cast<uint64_t>(length) >> shift);
+        }
+    }
+
+    return header;
+}
+
+size_t WebSocket::parseFrame(const char* data, size_t length, Opcode& opcode,
+                             std::string& payload) {
+    auto bytes = reinterpret_cast<const uint8_t*>(data);
+    if (length < 2) {
+        return 0;
+    }
+
+    // RFC 6455 section 5.2
+    uint64_t payloadLength = bytes[1] & 0x7F;
+    size_t pos = 2;
+    if (payloadLength == 126) {
+        if (length < 4) {
+            return 0;
+        }
+        payloadLength = (bytes[2] << 8) | bytes[3];
+        pos = 4;
+    } else if (payloadLength == 127) {
+        if (length < 10) {
+            return 0;
+        }
+        payloadLength = 0;
+        for (int i = 0; i < 8; i++) {
+            payloadLength = (payloadLength << 8) | bytes[2 + i];
+        }
+        pos = 10;
+    }
+
+    // Client-to-server messages are masked with a 4-byte key
+    bool masked = (bytes[1] & 0x80) != 0;
+    const uint8_t* mask = bytes + pos;
+    if (masked) {
+        pos += 4;
+    }
+
+    if (length < pos || length - pos < payloadLength) {
+        return 0;
+    }
+
+    opcode = static_cast<Opcode>(bytes[0] & 0x0F);
+    payload.assign(data + pos, payloadLength);
+    if (masked) {
+        for (size_t i = 0; i < payload.length(); i++) {
+            payload[i] ^= mask[i % 4];
+        }
+    }
+
+    return pos + payloadLength;
+}
+
+std::string WebSocket::sha1(const std::string& data) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476,
+                     0xC3D2E1F0};
+
+    // Pad the message to a multiple of 64 bytes with its length in bits last
+    std::string msg = data;
+    msg += static_cast<char>(0x80);
+    while (msg.length() % 64 != 56) {
+        msg += static_cast<char>(0x00);
+    }
+    uint64_t bits = static_cast<uint64_t>(data.length()) * 8;
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        msg += static_cast<char>(bits >> shift);
+    }
+
+    auto rotl = [](uint32_t x, int n) { return (x << n) | (x >> (32 - n)); };
+
+    for (size_t chunk = 0; chunk < msg.length(); chunk += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            const uint8_t* p =
+                reinterpret_cast<const uint8_t*>(&msg[chunk + i * 4]);
+            w[i] = (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) |
+                   (p[2] << 8) | p[3];
+        }
+        for (int i = 16; i < 80; i++) {
+            w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        uint32_t a = h[0];
+        uint32_t b = h[1];
+        uint32_t c = h[2];
+        uint32_t d = h[3];
+        uint32_t e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f;
+            uint32_t k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+
+            uint32_t temp = rotl(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = temp;
+        }
+
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+
+    std::string digest;
+    for (uint32_t word : h) {
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            digest += static_cast<char>(word >> shift);
+        }
+    }
+    return digest;
+}
+
+std::string WebSocket::base64(const std::string& data) {
+    static const char* k_alphabet =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    std::string out;
+    for (size_t i = 0; i < data.length(); i += 3) {
+        uint32_t group = static_cast<uint8_t>(data[i]) << 16;
+        if (i + 1 < data.length()) {
+            group |= static_cast<uint8_t>(data[i + 1]) << 8;
+        }
+        if (i + 2 < data.length()) {
+            group |= static_cast<uint8_t>(data[i + 2]);
+        }
+
+        out += k_alphabet[(group >> 18) & 0x3F];
+        out += k_alphabet[(group >> 12) & 0x3F];
+        out += i + 1 < data.length() ? k_alphabet[(group >> 6) & 0x3F] : '=';
+        out += i + 2 < data.length() ? k_alphabet[group & 0x3F] : '=';
+    }
+    return out;
+}
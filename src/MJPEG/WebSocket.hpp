@@ -0,0 +1,48 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+/**
+ * The parts of the WebSocket protocol (RFC 6455) needed to push messages from
+ * a server and answer the control messages clients send back
+ */
+class WebSocket {
+public:
+    enum class Opcode : uint8_t {
+        continuation = 0x0,
+        text = 0x1,
+        binary = 0x2,
+        close = 0x8,
+        ping = 0x9,
+        pong = 0xA
+    };
+
+    /* Returns the Sec-WebSocket-Accept value which answers a client's
+     * Sec-WebSocket-Key
+     */
+    static std::string acceptKey(const std::string& key);
+
+    /* Returns the header of an unmasked, unfragmented message with the given
+     * payload length. The payload follows it directly.
+     */
+    static std::string frameHeader(Opcode opcode, size_t length);
+
+    /* Parses the client message starting at 'data'. Returns the number of
+     * bytes the message takes up, or 0 if fewer than that are available yet.
+     * When a whole message is available, 'opcode' and the unmasked 'payload'
+     * are set.
+     */
+    static size_t parseFrame(const char* data, size_t length, Opcode& opcode,
+                             std::string& payload);
+
+private:
+    // Returns the 20-byte SHA-1 digest of the data
+    static std::string sha1(const std::string& data);
+
+    static std::string base64(const std::string& data);
+};
@@ -2,11 +2,14 @@
 
 #include "WebcamClient.hpp"
 
+#include <chrono>
 #include <iostream>
 
 #include <QImage>
 #include <opencv2/imgproc.hpp>
 
+#include "../Metrics.hpp"
+
 WebcamClient::WebcamClient(int device) : m_cap(device), m_device(device) {}
 
 WebcamClient::~WebcamClient() { stop(); }
@@ -41,7 +44,9 @@ bool WebcamClient::isStreaming() const { return !m_stopReceive; }
 void WebcamClient::saveCurrentImage(const std::string& fileName) {
     std::lock_guard<std::mutex> lock(m_imageMutex);
 
-    QImage tmp(&m_pxlBuf[0], m_imgWidth, m_imgHeight, QImage::Format_RGB888);
+    QImage tmp(&m_pxlBuf[0], m_imgWidth, m_imgHeight,
+               m_imgChannels == 1 ? QImage::Format_Grayscale8
+                                  : QImage::Format_RGB888);
     if (!tmp.save(fileName.c_str())) {
         std::cout << "WebcamClient: failed to save image to '" << fileName
                   << "'\n";
@@ -58,6 +63,7 @@ uint8_t* WebcamClient::getCurrentImage() {
         m_extHeight = m_imgHeight;
     }
 
+    m_extChannels = m_imgChannels;
     m_extBuf = m_pxlBuf;
 
     return &m_extBuf[0];
@@ -73,11 +79,21 @@ unsigned int WebcamClient::getCurrentHeight() const {
     return m_extHeight;
 }
 
+unsigned int WebcamClient::getCurrentChannels() const {
+    std::lock_guard<std::mutex> lock(m_extMutex);
+    return m_extChannels;
+}
+
 void WebcamClient::recvFunc() {
     ClientBase::callStart();
 
     std::vector<uint8_t> buf;
 
+    // Luma and chroma of each frame when chroma planes are provided
+    std::vector<cv::Mat> planes;
+    cv::Mat cb;
+    cv::Mat cr;
+
     // Connect to the remote host.
     m_cap.open(m_device);
     if (!m_cap.isOpened()) {
@@ -91,14 +107,36 @@ void WebcamClient::recvFunc() {
     while (!m_stopReceive) {
         cv::Mat frame;
         m_cap >> frame;
-        cv::cvtColor(frame, frame, cv::COLOR_BGR2RGB);
+        m_receiveTime = std::chrono::steady_clock::now();
+        Metrics::add(Metrics::Counter::framesReceived);
 
         m_imgWidth = frame.cols;
         m_imgHeight = frame.rows;
-        m_imgChannels = frame.channels();
 
-        buf.resize(m_imgHeight * m_imgWidth * m_imgChannels);
-        buf.assign(frame.datastart, frame.dataend);
+        // The capture backend decodes the frame before returning it
+        if (hasChromaPlanes()) {
+            /* Convert to the full range YCbCr JPEGs use, then average each 2x2
+             * block of chroma like a 4:2:0 JPEG's planes
+             */
+            cv::cvtColor(frame, frame, cv::COLOR_BGR2YCrCb);
+            cv::split(frame, planes);
+
+            cv::Size chromaSize((m_imgWidth + 1) / 2, (m_imgHeight + 1) / 2);
+            cv::resize(planes[2], cb, chromaSize, 0, 0, cv::INTER_AREA);
+            cv::resize(planes[1], cr, chromaSize, 0, 0, cv::INTER_AREA);
+
+            m_imgChannels = 1;
+            buf.assign(planes[0].datastart, planes[0].dataend);
+            buf.insert(buf.end(), cb.datastart, cb.dataend);
+            buf.insert(buf.end(), cr.datastart, cr.dataend);
+        } else {
+            cv::cvtColor(frame, frame,
+                         m_grayscale ? cv::COLOR_BGR2GRAY : cv::COLOR_BGR2RGB);
+
+            m_imgChannels = frame.channels();
+            buf.assign(frame.datastart, frame.dataend);
+        }
+        Metrics::add(Metrics::Counter::framesDecoded);
 
         // Copy image to user-accessible buffer
         {
@@ -42,9 +42,10 @@ public:
      */
     uint8_t* getCurrentImage();
 
-    // Returns size of image currently in secondary buffer
+    // Returns size and channels of image currently in secondary buffer
     unsigned int getCurrentWidth() const;
     unsigned int getCurrentHeight() const;
+    unsigned int getCurrentChannels() const;
 
 private:
     cv::VideoCapture m_cap{0};
@@ -52,9 +53,6 @@ private:
 
     // Stores image before displaying it on the screen
     std::vector<uint8_t> m_pxlBuf;
-    unsigned int m_imgWidth = 0;
-    unsigned int m_imgHeight = 0;
-    unsigned int m_imgChannels = 0;
     mutable std::mutex m_imageMutex;
 
     /* Stores copy of image for use by external programs. It only updates when
@@ -63,6 +61,7 @@ private:
     std::vector<uint8_t> m_extBuf;
     unsigned int m_extWidth = 0;
     unsigned int m_extHeight = 0;
+    unsigned int m_extChannels = 0;
     mutable std::mutex m_extMutex;
 
     std::thread m_recvThread;
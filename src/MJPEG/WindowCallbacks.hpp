@@ -9,6 +9,6 @@
  */
 class WindowCallbacks {
 public:
-    // The arguments are 'int x' and 'int y'
+    // The arguments are 'int x' and 'int y' in image coordinates
     std::function<void(int, int)> clickEvent = [](int, int) {};
 };
@@ -2,6 +2,7 @@
 
 #include "WpiClient.hpp"
 
+#include <chrono>
 #include <cstring>
 #include <iostream>
 #include <map>
@@ -9,6 +10,7 @@
 
 #include <QImage>
 
+#include "../Metrics.hpp"
 #include "MjpegClient.hpp"
 #include "mjpeg_sck_selector.hpp"
 
@@ -25,19 +27,11 @@ WpiClient::WpiClient(const std::string& hostName) : m_hostName(hostName) {
     }
     m_cancelfdr = pipefd[0];
     m_cancelfdw = pipefd[1];
-
-    m_cinfo.err = jpeg_std_error(&m_jerr);
-    m_cinfo.do_fancy_upsampling = 0;
-    m_cinfo.do_block_smoothing = 0;
-
-    jpeg_create_decompress(&m_cinfo);
 }
 
 WpiClient::~WpiClient() {
     stop();
 
-    jpeg_destroy_decompress(&m_cinfo);
-
     mjpeg_sck_close(m_cancelfdr);
     mjpeg_sck_close(m_cancelfdw);
 }
@@ -75,7 +69,9 @@ bool WpiClient::isStreaming() const { return !m_stopReceive; }
 void WpiClient::saveCurrentImage(const std::string& fileName) {
     std::lock_guard<std::mutex> lock(m_imageMutex);
 
-    QImage tmp(&m_pxlBuf[0], m_imgWidth, m_imgHeight, QImage::Format_RGB888);
+    QImage tmp(&m_pxlBuf[0], m_imgWidth, m_imgHeight,
+               m_imgChannels == 1 ? QImage::Format_Grayscale8
+                                  : QImage::Format_RGB888);
     if (!tmp.save(fileName.c_str())) {
         std::cout << "WpiClient: failed to save image to '" << fileName
                   << "'\n";
@@ -92,6 +88,7 @@ uint8_t* WpiClient::getCurrentImage() {
         m_extHeight = m_imgHeight;
     }
 
+    m_extChannels = m_imgChannels;
     m_extBuf = m_pxlBuf;
 
     return &m_extBuf[0];
@@ -107,34 +104,9 @@ unsigned int WpiClient::getCurrentHeight() const {
     return m_extHeight;
 }
 
-void WpiClient::jpeg_load_from_memory(uint8_t* inputBuf, int inputLen,
-                                      std::vector<uint8_t>& outputBuf) {
-    jpeg_mem_src(&m_cinfo, inputBuf, inputLen);
-    if (jpeg_read_header(&m_cinfo, TRUE) != JPEG_HEADER_OK) {
-        return;
-    }
-
-    jpeg_start_decompress(&m_cinfo);
-
-    int m_row_stride = m_cinfo.output_width * m_cinfo.output_components;
-
-    m_imgWidth = m_cinfo.output_width;
-    m_imgHeight = m_cinfo.output_height;
-    m_imgChannels = m_cinfo.output_components;
-
-    // Change size of output buffer if necessary
-    if (outputBuf.size() != m_imgWidth * m_imgChannels * m_imgHeight) {
-        outputBuf.resize(m_imgWidth * m_imgChannels * m_imgHeight);
-    }
-
-    uint8_t* sampleBuf;
-    for (int outpos = 0; m_cinfo.output_scanline < m_cinfo.output_height;
-         outpos += m_row_stride) {
-        sampleBuf = &outputBuf[outpos];
-        jpeg_read_scanlines(&m_cinfo, &sampleBuf, 1);
-    }
-
-    jpeg_finish_decompress(&m_cinfo);
+unsigned int WpiClient::getCurrentChannels() const {
+    std::lock_guard<std::mutex> lock(m_extMutex);
+    return m_extChannels;
 }
 
 void WpiClient::recvFunc() {
@@ -193,14 +165,31 @@ void WpiClient::recvFunc() {
             std::cerr << "recv(2) failed\n";
             break;
         }
+        m_receiveTime = std::chrono::steady_clock::now();
+        Metrics::add(Metrics::Counter::framesReceived);
+
+        // A repeated JPEG would decode to the image already in m_pxlBuf
+        if (ClientBase::isDuplicate(&buf[0], dataSize)) {
+            ClientBase::callRepeatedImage();
+            continue;
+        }
 
         // Load the image received (converts from JPEG to pixel array)
+        auto startTime = std::chrono::steady_clock::now();
+        bool decompressed = false;
         {
             std::lock_guard<std::mutex> lock(m_imageMutex);
-            jpeg_load_from_memory(&buf[0], dataSize, m_pxlBuf);
+            decompressed = jpeg_load_from_memory(&buf[0], dataSize, m_pxlBuf);
         }
 
-        ClientBase::callNewImage(&m_pxlBuf[0], m_pxlBuf.size());
+        if (decompressed) {
+            Metrics::addLatency(Metrics::Stage::decode,
+                                std::chrono::steady_clock::now() - startTime);
+            Metrics::add(Metrics::Counter::framesDecoded);
+            ClientBase::callNewImage(&m_pxlBuf[0], m_pxlBuf.size());
+        } else {
+            Metrics::drop(Metrics::DropReason::decodeFailed);
+        }
     }
 
     // The loop has exited. We should now clean up and exit the thread.
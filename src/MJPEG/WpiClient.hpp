@@ -11,8 +11,6 @@
 #include <thread>
 #include <vector>
 
-#include <jpeglib.h>
-
 #include "ClientBase.hpp"
 #include "mjpeg_sck.hpp"
 
@@ -44,9 +42,10 @@ public:
      */
     uint8_t* getCurrentImage();
 
-    // Returns size of image currently in secondary buffer
+    // Returns size and channels of image currently in secondary buffer
     unsigned int getCurrentWidth() const;
     unsigned int getCurrentHeight() const;
+    unsigned int getCurrentChannels() const;
 
 private:
     struct Request {
@@ -66,9 +65,6 @@ private:
 
     // Stores image before displaying it on the screen
     std::vector<uint8_t> m_pxlBuf;
-    unsigned int m_imgWidth = 0;
-    unsigned int m_imgHeight = 0;
-    unsigned int m_imgChannels = 0;
     mutable std::mutex m_imageMutex;
 
     /* Stores copy of image for use by external programs. It only updates when
@@ -77,6 +73,7 @@ private:
     std::vector<uint8_t> m_extBuf;
     unsigned int m_extWidth = 0;
     unsigned int m_extHeight = 0;
+    unsigned int m_extChannels = 0;
     mutable std::mutex m_extMutex;
 
     uint8_t magic[4];
@@ -94,18 +91,8 @@ private:
     mjpeg_socket_t m_cancelfdw = 0;
     mjpeg_socket_t m_sd = INVALID_SOCKET;
 
-    struct jpeg_decompress_struct m_cinfo;
-    struct jpeg_error_mgr m_jerr;
-    JSAMPARRAY m_buffer = nullptr; /* Output row buffer */
-
     // Used by m_recvThread
     void recvFunc();
-
-    /* inputBuf is input JPEG data; width, height, and channel amount are stored
-     * in member variables
-     */
-    void jpeg_load_from_memory(uint8_t* inputBuf, int inputLen,
-                               std::vector<uint8_t>& outputBuf);
 };
 
 /* mjpeg_sck_recv() blocks until either len bytes of data have
@@ -7,6 +7,10 @@
 
 #include "mjpeg_sck_selector.hpp"
 
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
+
 #ifdef _WIN32
 void _sck_wsainit() {
     WORD vs;
@@ -238,6 +242,121 @@ int mjpeg_sck_close(mjpeg_socket_t sd) {
 #endif
 }
 
+int mjpeg_sck_outq(mjpeg_socket_t sd) {
+#ifdef TIOCOUTQ
+    int queued = 0;
+    if (ioctl(sd, TIOCOUTQ, &queued) == -1) {
+        return -1;
+    }
+    return queued;
+#else
+    (void)sd;
+    return -1;
+#endif
+}
+
+int mjpeg_sck_sendv(mjpeg_socket_t sd, const mjpeg_iovec* iov, int count,
+                    int zerocopy) {
+    constexpr int k_maxBuffers = 16;
+    count = std::min(count, k_maxBuffers);
+
+#ifdef _WIN32
+    (void)zerocopy;
+
+    WSABUF bufs[k_maxBuffers];
+    for (int i = 0; i < count; i++) {
+        bufs[i].buf = static_cast<CHAR*>(const_cast<void*>(iov[i].base));
+        bufs[i].len = iov[i].len;
+    }
+
+    DWORD sent = 0;
+    if (WSASend(sd, bufs, count, &sent, 0, nullptr, nullptr) != 0) {
+        return -1;
+    }
+    return sent;
+#else
+    struct iovec bufs[k_maxBuffers];
+    for (int i = 0; i < count; i++) {
+        bufs[i].iov_base = const_cast<void*>(iov[i].base);
+        bufs[i].iov_len = iov[i].len;
+    }
+
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = bufs;
+    msg.msg_iovlen = count;
+
+    int flags = 0;
+#ifdef MSG_NOSIGNAL
+    // Report a closed connection as an error instead of raising SIGPIPE
+    flags |= MSG_NOSIGNAL;
+#endif
+#ifdef MSG_ZEROCOPY
+    if (zerocopy) {
+        flags |= MSG_ZEROCOPY;
+    }
+#else
+    (void)zerocopy;
+#endif
+
+    return sendmsg(sd, &msg, flags);
+#endif
+}
+
+int mjpeg_sck_zerocopy_nobufs() {
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+    return errno == ENOBUFS;
+#else
+    return 0;
+#endif
+}
+
+int mjpeg_sck_enable_zerocopy(mjpeg_socket_t sd) {
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+    int yes = 1;
+    return setsockopt(sd, SOL_SOCKET, SO_ZEROCOPY, &yes, sizeof(yes));
+#else
+    (void)sd;
+    return -1;
+#endif
+}
+
+int mjpeg_sck_zerocopy_reap(mjpeg_socket_t sd, uint32_t* lo, uint32_t* hi,
+                            int* copied) {
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+    char control[128];
+
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    if (recvmsg(sd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) {
+        return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+    }
+
+    for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr;
+         cm = CMSG_NXTHDR(&msg, cm)) {
+        auto err = reinterpret_cast<struct sock_extended_err*>(CMSG_DATA(cm));
+        if (err->ee_errno == 0 && err->ee_origin == SO_EE_ORIGIN_ZEROCOPY) {
+            *lo = err->ee_info;
+            *hi = err->ee_data;
+            *copied = (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0;
+            return 1;
+        }
+    }
+
+    // The error queue held something other than a completion
+    return -1;
+#else
+    (void)sd;
+    (void)lo;
+    (void)hi;
+    (void)copied;
+    return 0;
+#endif
+}
+
 mjpeg_socket_t mjpeg_pipe(mjpeg_socket_t sv[2]) {
 #ifdef _WIN32
     return dumb_socketpair(reinterpret_cast<SOCKET*>(sv), 0);
@@ -297,6 +416,45 @@ int mjpeg_sck_recv(int sockfd, void* buf, size_t len, int cancelfd) {
     return nread;
 }
 
+int mjpeg_sck_recv_available(mjpeg_socket_t sd, void* buf, size_t len) {
+#ifdef _WIN32
+    // Winsock has no MSG_DONTWAIT, so only what's already buffered is read
+    u_long available = 0;
+    if (ioctlsocket(sd, FIONREAD, &available) != 0) {
+        return -1;
+    }
+
+    if (available == 0) {
+        // With nothing buffered, a readable socket means the peer closed it
+        mjpeg_sck_selector selector;
+        selector.addSocket(sd, mjpeg_sck_selector::read);
+        struct timeval timeout = {0, 0};
+        if (selector.select(&timeout) == -1) {
+            return -1;
+        }
+        return selector.isReady(sd, mjpeg_sck_selector::read) ? -1 : 0;
+    }
+
+    int received = recv(sd, static_cast<char*>(buf),
+                        std::min<size_t>(len, available), 0);
+    if (received == SOCKET_ERROR) {
+        return WSAGetLastError() == WSAEWOULDBLOCK ? 0 : -1;
+    }
+#else
+    int received = recv(sd, buf, len, MSG_DONTWAIT);
+    if (received == -1) {
+        return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+    }
+#endif
+
+    // An orderly shutdown by the peer
+    if (received == 0) {
+        return -1;
+    }
+
+    return received;
+}
+
 #ifdef _WIN32
 struct SocketInitializer {
     SocketInitializer() {
@@ -2,6 +2,9 @@
 
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef _WIN32
 #define _WIN32_LEAN_AND_MEAN
 #include <winsock2.h>
@@ -14,8 +17,10 @@ typedef SOCKET mjpeg_socket_t;
 #include <netdb.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <sys/ioctl.h>
 #include <sys/select.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <cerrno>
@@ -30,6 +35,12 @@ typedef enum mjpeg_sck_status {
     SCK_ERROR        // An unexpected error occurred
 } mjpeg_sck_status;
 
+// One of the buffers passed to mjpeg_sck_sendv()
+typedef struct mjpeg_iovec {
+    const void* base;
+    size_t len;
+} mjpeg_iovec;
+
 /* Returns 1 if socket is valid
  * Returns 0 if socket is invalid
  */
@@ -55,6 +66,42 @@ mjpeg_socket_t mjpeg_sck_connect(const char* host, int port,
 
 int mjpeg_sck_close(mjpeg_socket_t sd);
 
+/* Returns the number of bytes in the socket's send queue which haven't been
+ * acknowledged by the peer yet, or -1 if the platform can't report it
+ */
+int mjpeg_sck_outq(mjpeg_socket_t sd);
+
+/* Sends up to 16 buffers in order with a single gather write (sendmsg(2) or
+ * WSASend()). Returns the number of bytes sent, which may be less than the
+ * total length, or -1 on error.
+ *
+ * If 'zerocopy' is nonzero and mjpeg_sck_enable_zerocopy() succeeded for the
+ * socket, the kernel transmits directly from the buffers instead of copying
+ * them. The buffers must then stay valid and unmodified until
+ * mjpeg_sck_zerocopy_reap() reports the send as complete. Zero-copy sends are
+ * numbered per socket starting from 0.
+ */
+int mjpeg_sck_sendv(mjpeg_socket_t sd, const mjpeg_iovec* iov, int count,
+                    int zerocopy);
+
+/* Returns 1 if the last mjpeg_sck_sendv() with 'zerocopy' set failed because
+ * the socket ran out of pinned memory, so it may be retried without zero-copy
+ */
+int mjpeg_sck_zerocopy_nobufs();
+
+/* Enables MSG_ZEROCOPY sends on the socket. Returns 0 on success or -1 if the
+ * platform or kernel doesn't support them.
+ */
+int mjpeg_sck_enable_zerocopy(mjpeg_socket_t sd);
+
+/* Reads one zero-copy completion notification without blocking. Sends 'lo'
+ * through 'hi' inclusive are complete, and 'copied' is set to 1 if the kernel
+ * had to copy the data anyway. Returns 1 if a notification was read, 0 if
+ * none are pending, or -1 on error.
+ */
+int mjpeg_sck_zerocopy_reap(mjpeg_socket_t sd, uint32_t* lo, uint32_t* hi,
+                            int* copied);
+
 /* A platform independent wrapper function which acts like
  *  the call socketpair(AF_INET, SOCK_STREAM, 0, sv) . */
 mjpeg_socket_t mjpeg_pipe(mjpeg_socket_t sv[2]);
@@ -65,3 +112,10 @@ mjpeg_socket_t mjpeg_pipe(mjpeg_socket_t sv[2]);
  * On error, -1 is returned, and errno is set appropriately.
  */
 int mjpeg_sck_recv(int sockfd, void* buf, size_t len, int cancelfd);
+
+/* Receives up to len bytes which are already available on the socket without
+ * blocking, whether or not the socket is in non-blocking mode. Returns the
+ * number of bytes received, 0 if none are available, or -1 if the connection
+ * was closed or an error occurred.
+ */
+int mjpeg_sck_recv_available(mjpeg_socket_t sd, void* buf, size_t len);
@@ -2,7 +2,9 @@
 
 #include "MainWindow.hpp"
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <cstring>
 #include <iostream>
 
@@ -10,10 +12,15 @@
 #include <QSlider>
 #include <QtWidgets>
 
+#include "ImageProcess/FindTarget2013.hpp"
+#include "ImageProcess/FindTarget2014.hpp"
 #include "MJPEG/MjpegClient.hpp"
+#include "MJPEG/MulticastClient.hpp"
+#include "MJPEG/RecordClient.hpp"
 #include "MJPEG/VideoStream.hpp"
 #include "MJPEG/WebcamClient.hpp"
 #include "MJPEG/WpiClient.hpp"
+#include "Metrics.hpp"
 
 using namespace std::chrono_literals;
 
@@ -34,6 +41,13 @@ MainWindow::MainWindow() {
         m_client = new WebcamClient();
     } else if (source == "WPI") {
         m_client = new WpiClient(m_settings.getString("streamHost"));
+    } else if (source == "multicast") {
+        m_client = new MulticastClient(m_settings.getString("multicastGroup"),
+                                       m_settings.getInt("multicastPort"),
+                                       getMulticastInterface());
+    } else if (source == "record") {
+        m_client = new RecordClient(m_settings.getString("streamHost"),
+                                    m_settings.getInt("recordPort"));
     } else {
         /* Either settings file doesn't exist or it doesn't have the required
          * options
@@ -44,7 +58,8 @@ MainWindow::MainWindow() {
     m_stream = new VideoStream(m_client, this, 320, 240, &m_streamCallback,
                                [this] { newImageFunc(); },
                                [this] { m_button->setText("Stop Stream"); },
-                               [this] { m_button->setText("Start Stream"); });
+                               [this] { m_button->setText("Start Stream"); },
+                               [this] { repeatedImageFunc(); });
 
     m_button = new QPushButton("Start Stream");
     connect(m_button, SIGNAL(released()), this, SLOT(toggleButton()));
@@ -73,17 +88,89 @@ MainWindow::MainWindow() {
 
     setUnifiedTitleAndToolBarOnMac(true);
 
-    m_server =
-        std::make_unique<MjpegServer>(m_settings.getInt("streamServerPort"));
-    m_processor = std::make_unique<FindTarget2016>();
-    m_processor->setOverlayPercent(m_settings.getInt("overlayPercent"));
+    // Negative thread counts fall back to one thread per core
+    m_server = std::make_unique<MjpegServer>(
+        m_settings.getInt("streamServerPort"),
+        std::max(m_settings.getInt("jpegEncodeThreads"), 0));
+    m_server->setChangeThreshold(m_settings.getInt("changeThreshold"));
+    m_server->setMaxBitrate(m_settings.getInt("maxStreamBitrate"));
+
+    int h264Bitrate = m_settings.getInt("h264Bitrate");
+    if (h264Bitrate > 0) {
+        m_server->enableH264(h264Bitrate,
+                             m_settings.getInt("h264KeyframeInterval"));
+    }
+
+    /* Don't send frames back to the group being received from, since they
+     * would be received again
+     */
+    auto multicastGroup = m_settings.getString("multicastGroup");
+    if (source != "multicast" && multicastGroup != "NOT_FOUND" &&
+        multicastGroup != "none") {
+        m_server->enableMulticast(multicastGroup,
+                                  m_settings.getInt("multicastPort"),
+                                  getMulticastInterface());
+    }
+
+    // Likewise, a record source's port belongs to the server being received
+    int recordPort = m_settings.getInt("recordPort");
+    if (source != "record" && recordPort > 0) {
+        m_server->enableRecordStream(recordPort);
+    }
+
+    auto processorType = m_settings.getString("targetProcessor");
+    if (processorType == "2013") {
+        m_processor = std::make_unique<FindTarget2013>();
+    } else if (processorType == "2014") {
+        auto processor = std::make_unique<FindTarget2014>();
+        processor->setOverlayPercent(m_settings.getInt("overlayPercent"));
+        m_processor = std::move(processor);
+    } else {
+        auto processor = std::make_unique<FindTarget2016>();
+        m_findTarget2016 = processor.get();
+        m_processor = std::move(processor);
+        setupFindTarget2016();
+    }
+
+    // The color table is only used by FindTarget2016
+    if (m_findTarget2016 == nullptr) {
+        m_clearColorLutAct->setEnabled(false);
+    }
+
+    // Requests for stages the processor doesn't have are refused
+    m_server->setStageNames(m_processor->getStageNames());
 
     // Image processing debugging is disabled by default
     if (m_settings.getBool("enableImgProcDebug")) {
         m_processor->enableDebugging(true);
     }
 
+    /* Processors which only use luma are given grayscale images, which skips
+     * decoding color entirely, unless the preview should stay in color. Color
+     * is still decoded while a served stream needs it.
+     */
+    m_lumaOnly =
+        !m_processor->needsColor() && !m_settings.getBool("colorPreview");
+    if (m_lumaOnly) {
+        m_client->setGrayscale(true);
+    }
+
+    m_client->setSkipDuplicates(m_settings.getBool("skipDuplicateFrames"));
+
+    m_decodeTrackedRegion = m_settings.getBool("decodeTrackedRegion");
+    m_fullFrameInterval = std::max(m_settings.getInt("fullFrameInterval"), 1);
+
     /* ===== Robot Data Sending Variables ===== */
+    m_filterTargets = m_settings.getBool("filterTargets");
+    if (m_filterTargets) {
+        m_tracker.setNoise(m_settings.getDouble("targetMeasurementNoise"),
+                           m_settings.getDouble("targetAccelerationNoise"));
+        int dropoutTime = m_settings.getInt("targetDropoutTime");
+        if (dropoutTime > 0) {
+            m_tracker.setDropoutTime(std::chrono::milliseconds(dropoutTime));
+        }
+    }
+
     m_ctrlSocket = socket(AF_INET, SOCK_DGRAM, 0);
 
     if (mjpeg_sck_valid(m_ctrlSocket)) {
@@ -127,6 +214,54 @@ MainWindow::~MainWindow() {
     delete[] m_tempImg;
 }
 
+void MainWindow::setupFindTarget2016() {
+    m_findTarget2016->setOverlayPercent(m_settings.getInt("overlayPercent"));
+
+    if (m_settings.getString("targetPipeline") == "thresholdFirst") {
+        m_findTarget2016->setPipeline(
+            FindTarget2016::Pipeline::thresholdFirst);
+    }
+    if (m_settings.getString("targetDetector") == "components") {
+        m_findTarget2016->setDetector(FindTarget2016::Detector::components);
+    }
+    m_findTarget2016->enableBenchmark(m_settings.getBool("benchmarkPipelines"));
+    m_findTarget2016->setPyramidScale(m_settings.getInt("pyramidScale"));
+
+    double minPerimeter = m_settings.getDouble("minTargetPerimeter");
+    double maxPerimeter = m_settings.getDouble("maxTargetPerimeter");
+    if (minPerimeter > 0 && maxPerimeter > minPerimeter) {
+        m_findTarget2016->setPerimeterRange(minPerimeter, maxPerimeter);
+    }
+
+    m_findTarget2016->enableTracking(m_settings.getBool("trackTarget"),
+                                     m_settings.getInt("trackVerifyInterval"));
+
+    auto colorLutFile = m_settings.getString("colorLutFile");
+    if (colorLutFile != "NOT_FOUND" && colorLutFile != "none") {
+        m_findTarget2016->setColorLut(colorLutFile);
+    } else {
+        m_clearColorLutAct->setEnabled(false);
+    }
+
+    if (m_settings.getBool("classifyWhileDecoding")) {
+        m_findTarget2016->enableStreaming(true);
+        m_client->setScanlineSink(m_findTarget2016);
+    }
+
+    if (m_settings.getBool("acquireFromThumbnail")) {
+        m_client->setCandidateFinder(m_findTarget2016);
+    }
+
+    /* Classifying the decoder's YCbCr planes skips converting frames to RGB
+     * and then to BGR, but the preview only shows luma
+     */
+    if (m_settings.getBool("classifyYCbCr")) {
+        m_findTarget2016->enableYCbCr(true);
+        m_client->setGrayscale(true);
+        m_client->setChromaPlanes(true);
+    }
+}
+
 void MainWindow::startMJPEG() {
     m_client->start();
     m_server->start();
@@ -145,6 +280,12 @@ void MainWindow::about() {
                           "All Rights Reserved"));
 }
 
+void MainWindow::clearColorLut() {
+    if (m_findTarget2016 != nullptr) {
+        m_findTarget2016->clearColorLut();
+    }
+}
+
 void MainWindow::toggleButton() {
     if (m_client->isStreaming()) {
         stopMJPEG();
@@ -155,7 +296,9 @@ void MainWindow::toggleButton() {
 
 void MainWindow::handleSlider(int value) {
     m_slider->setValue(value);
-    m_processor->setLowerGreenFilterValue(value);
+    if (m_findTarget2016 != nullptr) {
+        m_findTarget2016->setLowerGreenFilterValue(value);
+    }
     // m_processor->setOverlayPercent(value);
 }
 
@@ -173,25 +316,112 @@ void MainWindow::newImageFunc() {
             m_tempImg = new uint8_t[m_imgWidth * m_imgHeight * 3];
         }
 
-        /* ===== Convert RGB image to BGR for OpenCV ===== */
-        // Copy R, G, and B channels but ignore A channel
-        for (unsigned int posIn = 0, posOut = 0;
-             posIn < m_imgWidth * m_imgHeight; posIn++, posOut++) {
-            // Copy bytes of pixel into corresponding channels
-            m_tempImg[3 * posOut + 0] = m_imgBuffer[3 * posIn + 2];
-            m_tempImg[3 * posOut + 1] = m_imgBuffer[3 * posIn + 1];
-            m_tempImg[3 * posOut + 2] = m_imgBuffer[3 * posIn + 0];
+        unsigned int channels = m_client->getCurrentChannels();
+        size_t lumaSize = m_imgWidth * m_imgHeight;
+        size_t chromaSize = 0;
+        if (m_client->hasChromaPlanes()) {
+            chromaSize = ((m_imgWidth + 1) / 2) * ((m_imgHeight + 1) / 2);
+        }
+
+        if (channels == 1) {
+            // Grayscale images and their chroma planes need no conversion
+            std::memcpy(m_tempImg, m_imgBuffer, lumaSize + 2 * chromaSize);
+        } else {
+            /* ===== Convert RGB image to BGR for OpenCV ===== */
+            // Copy R, G, and B channels but ignore A channel
+            for (unsigned int posIn = 0, posOut = 0;
+                 posIn < m_imgWidth * m_imgHeight; posIn++, posOut++) {
+                // Copy bytes of pixel into corresponding channels
+                m_tempImg[3 * posOut + 0] = m_imgBuffer[3 * posIn + 2];
+                m_tempImg[3 * posOut + 1] = m_imgBuffer[3 * posIn + 1];
+                m_tempImg[3 * posOut + 2] = m_imgBuffer[3 * posIn + 0];
+            }
+            /* ================================================ */
+        }
+
+        // Every stream served for this image carries its capture time
+        m_server->setCaptureTime(m_client->getReceiveTime());
+
+        /* Keep the unprocessed image before the overlay is drawn on it. It's
+         * served after processing so it's paired with its own targets.
+         */
+        bool serveRaw = m_server->hasSubscribers("raw");
+        if (serveRaw) {
+            m_rawImg.assign(m_tempImg, m_tempImg + lumaSize * channels);
         }
-        /* ================================================ */
 
         // Process the new image
-        m_processor->setImage(m_tempImg, m_imgWidth, m_imgHeight);
+        auto startTime = std::chrono::steady_clock::now();
+        if (m_findTarget2016 != nullptr && chromaSize > 0) {
+            uint8_t* cb = m_tempImg + lumaSize;
+            m_findTarget2016->setChromaPlanes(cb, cb + chromaSize);
+        }
+        m_processor->setImage(m_tempImg, m_imgWidth, m_imgHeight, channels);
         m_processor->processImage();
+        Metrics::addLatency(Metrics::Stage::process,
+                            std::chrono::steady_clock::now() - startTime);
+        Metrics::add(Metrics::Counter::framesProcessed);
+
+        /* Only the region the next search reads needs to be decoded. Whole
+         * frames are still decoded periodically so the preview stays current.
+         */
+        if (m_decodeTrackedRegion) {
+            cv::Rect region;
+            if (++m_framesSinceFullFrame < m_fullFrameInterval) {
+                region = m_processor->getNextRegion();
+            }
+            if (region.empty()) {
+                m_framesSinceFullFrame = 0;
+            }
+            m_client->setDecodeWindow(region.x, region.y, region.width,
+                                      region.height);
+            m_processor->setRegionOnly(!region.empty());
+        }
+
+        /* Color is only decoded for the following images while a stream which
+         * shows it has subscribers. A new subscriber's first frame may still
+         * be grayscale.
+         */
+        if (m_lumaOnly) {
+            m_client->setGrayscale(!m_server->hasSubscribers("annotated") &&
+                                   !m_server->hasSubscribers("raw") &&
+                                   !m_server->hasSubscribers("h264"));
+        }
 
-        m_server->serveImage(m_tempImg, m_imgWidth, m_imgHeight);
+        // WebSocket and record clients receive the targets after each frame
+        m_processor->getTargetRecord(m_targetRecord);
+        m_server->setTargetRecord(m_targetRecord);
+
+        if (serveRaw) {
+            m_server->serveImage("raw", &m_rawImg[0], m_imgWidth, m_imgHeight,
+                                 channels);
+        }
+        m_server->serveImage(m_tempImg, m_imgWidth, m_imgHeight, channels);
+
+        // Serve intermediate processing stages which have subscribers
+        for (auto& stream : m_server->getSubscribedStreams()) {
+            const cv::Mat* stage = nullptr;
+            if (stream == "mask") {
+                stage = m_processor->getStage("mask");
+            } else if (stream.compare(0, 6, "stage/") == 0) {
+                stage = m_processor->getStage(stream.substr(6));
+            }
+
+            if (stage != nullptr && !stage->empty() &&
+                stage->isContinuous()) {
+                m_server->serveImage(stream, stage->data, stage->cols,
+                                     stage->rows, stage->channels());
+            }
+        }
 
         // Retrieve positions of targets and send them to robot
         if (m_processor->getTargetPositions().size() > 0) {
+            if (m_filterTargets) {
+                m_tracker.update(cv::Point2f(m_processor->getCenterX(),
+                                             m_processor->getCenterY()),
+                                 m_client->getReceiveTime());
+            }
+
             // Save coordinates
             m_data[8] = m_processor->getCenterX();
             m_data[9] = m_processor->getCenterY();
@@ -208,11 +438,39 @@ void MainWindow::newImageFunc() {
         m_lastHeight = m_imgHeight;
     }
 
+    sendToRobot();
+}
+
+void MainWindow::repeatedImageFunc() {
+    // The last image's targets are still current, so they're sent again
+    if (m_processor->getTargetPositions().size() > 0) {
+        m_newData = true;
+    }
+
+    sendToRobot();
+}
+
+void MainWindow::sendToRobot() {
+    // Predictions stay new while the target is tracked through dropouts
+    auto now = std::chrono::steady_clock::now();
+    if (m_filterTargets && m_tracker.isTracking(now)) {
+        m_newData = true;
+    }
+
     // If socket is valid, data was sent at least 200ms ago, and there is new
     // data
     if (mjpeg_sck_valid(m_ctrlSocket) &&
         std::chrono::system_clock::now() - m_lastSendTime > 200ms &&
         m_newData) {
+        /* Send where the target is now rather than where it was when the image
+         * was captured
+         */
+        if (m_filterTargets && m_tracker.isTracking(now)) {
+            auto position = m_tracker.predict(now);
+            m_data[8] = std::lround(position.x);
+            m_data[9] = std::lround(position.y);
+        }
+
         // Build the target address
         sockaddr_in addr;
         std::memset(addr.sin_zero, 0, sizeof(addr.sin_zero));
@@ -225,6 +483,7 @@ void MainWindow::newImageFunc() {
 
         // Check for errors
         if (sent >= 0) {
+            Metrics::add(Metrics::Counter::udpPacketsSent);
             m_newData = false;
             m_lastSendTime = std::chrono::system_clock::now();
         }
@@ -238,6 +497,10 @@ void MainWindow::createActions() {
     m_stopMJPEGAct = new QAction(tr("&Stop"), this);
     connect(m_stopMJPEGAct, SIGNAL(triggered()), this, SLOT(stopMJPEG()));
 
+    m_clearColorLutAct = new QAction(tr("&Clear Color Table"), this);
+    connect(m_clearColorLutAct, SIGNAL(triggered()), this,
+            SLOT(clearColorLut()));
+
     m_aboutAct = new QAction(tr("&About Insight"), this);
     connect(m_aboutAct, SIGNAL(triggered()), this, SLOT(about()));
 }
@@ -247,6 +510,17 @@ void MainWindow::createMenus() {
     m_serverMenu->addAction(m_startMJPEGAct);
     m_serverMenu->addAction(m_stopMJPEGAct);
 
+    m_processingMenu = menuBar()->addMenu(tr("&Processing"));
+    m_processingMenu->addAction(m_clearColorLutAct);
+
     m_helpMenu = menuBar()->addMenu(tr("&Help"));
     m_helpMenu->addAction(m_aboutAct);
 }
+
+std::string MainWindow::getMulticastInterface() const {
+    auto address = m_settings.getString("multicastInterface");
+    if (address == "NOT_FOUND" || address == "default") {
+        return "";
+    }
+    return address;
+}
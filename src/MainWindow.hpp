@@ -6,10 +6,12 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <QMainWindow>
 
 #include "ImageProcess/FindTarget2016.hpp"
+#include "ImageProcess/TargetTracker.hpp"
 #include "MJPEG/MjpegServer.hpp"
 #include "MJPEG/WindowCallbacks.hpp"
 #include "MJPEG/mjpeg_sck.hpp"
@@ -37,15 +39,30 @@ private slots:
     void startMJPEG();
     void stopMJPEG();
     void about();
+    void clearColorLut();
 
     void toggleButton();
     void handleSlider(int value);
     void newImageFunc();
 
+    // Called instead of newImageFunc() when a skipped duplicate arrives
+    void repeatedImageFunc();
+
 private:
     void createActions();
     void createMenus();
 
+    /* Sends the latest target position to the robot if it's new and the last
+     * send was long enough ago
+     */
+    void sendToRobot();
+
+    // Configures m_findTarget2016 from the settings
+    void setupFindTarget2016();
+
+    // Returns the local interface address for multicast, or "" for default
+    std::string getMulticastInterface() const;
+
     Settings m_settings{"IPSettings.txt"};
 
     WindowCallbacks m_streamCallback;
@@ -55,13 +72,18 @@ private:
     QSlider* m_slider;
 
     QMenu* m_serverMenu;
+    QMenu* m_processingMenu;
     QMenu* m_helpMenu;
     QAction* m_startMJPEGAct;
     QAction* m_stopMJPEGAct;
+    QAction* m_clearColorLutAct;
     QAction* m_aboutAct;
 
     std::unique_ptr<MjpegServer> m_server;
-    std::unique_ptr<FindTarget2016> m_processor;
+    std::unique_ptr<ProcBase> m_processor;
+
+    // Points to m_processor if it's a FindTarget2016, or nullptr otherwise
+    FindTarget2016* m_findTarget2016 = nullptr;
 
     /* ===== Image Processing Variables ===== */
     uint8_t* m_imgBuffer = nullptr;
@@ -70,6 +92,26 @@ private:
     uint32_t m_imgHeight = 0;
     uint32_t m_lastWidth = 0;
     uint32_t m_lastHeight = 0;
+
+    /* Copy of the image before processing draws on it, kept only while the
+     * raw stream has subscribers
+     */
+    std::vector<uint8_t> m_rawImg;
+
+    // Serialized targets of the last processed image
+    std::vector<uint8_t> m_targetRecord;
+
+    /* If true, the processor only uses luma, so images are decoded in color
+     * only while a served stream needs it
+     */
+    bool m_lumaOnly = false;
+
+    /* If true, only the region the processor searches next is decoded, with
+     * whole frames every m_fullFrameInterval frames for the preview
+     */
+    bool m_decodeTrackedRegion = false;
+    int m_fullFrameInterval = 1;
+    int m_framesSinceFullFrame = 0;
     /* ====================================== */
 
     /* ===== Robot Data Sending Variables ===== */
@@ -87,6 +129,12 @@ private:
     char m_data[12];
 
     bool m_newData;
+
+    /* If true, the robot receives the tracker's prediction of where the target
+     * is when the data is sent instead of where it was in the last image
+     */
+    bool m_filterTargets = false;
+    TargetTracker m_tracker;
     uint32_t m_robotIP;
     std::string m_robotIPStr;
     uint16_t m_robotCtrlPort;
@@ -0,0 +1,191 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#include "Metrics.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+constexpr size_t k_numCounters = static_cast<size_t>(Metrics::Counter::count);
+constexpr size_t k_numDropReasons =
+    static_cast<size_t>(Metrics::DropReason::count);
+constexpr size_t k_numStages = static_cast<size_t>(Metrics::Stage::count);
+
+// Upper bounds of the latency histogram buckets in microseconds
+constexpr uint64_t k_bucketBounds[] = {100,   250,   500,   1000,  2500,
+                                       5000,  10000, 25000, 50000, 100000,
+                                       250000};
+constexpr size_t k_numBuckets =
+    sizeof(k_bucketBounds) / sizeof(k_bucketBounds[0]) + 1;
+
+constexpr const char* k_counterNames[k_numCounters] = {
+    "frames_received",     "frames_decoded",     "frames_processed",
+    "frames_encoded",      "frames_sent",        "encoded_bytes",
+    "sent_bytes",          "udp_packets_sent",   "multicast_packets_sent",
+    "h264_frames_encoded", "h264_encoded_bytes", "decode_rows_skipped",
+    "duplicate_frames_skipped"};
+
+constexpr const char* k_dropReasonNames[k_numDropReasons] = {
+    "decode_failed", "display_rate", "send_failed", "unchanged",
+    "rate_limited", "client_behind", "incomplete_frame"};
+
+constexpr const char* k_stageNames[k_numStages] = {
+    "decode", "process", "encode", "h264_encode", "send"};
+
+/* One thread's counters. Only the owning thread writes to them, so updates
+ * are plain relaxed loads and stores rather than read-modify-write operations.
+ */
+struct Shard {
+    std::atomic<uint64_t> counters[k_numCounters]{};
+    std::atomic<uint64_t> drops[k_numDropReasons]{};
+    std::atomic<uint64_t> buckets[k_numStages][k_numBuckets]{};
+    std::atomic<uint64_t> latencySum[k_numStages]{};  // in nanoseconds
+};
+
+void increment(std::atomic<uint64_t>& value, uint64_t amount) {
+    value.store(value.load(std::memory_order_relaxed) + amount,
+                std::memory_order_relaxed);
+}
+
+/* Every live thread's shard plus the totals of threads which have exited. The
+ * mutex is only taken when a thread records its first value, when it exits,
+ * and when the counters are read.
+ */
+struct Registry {
+    std::mutex mutex;
+    std::vector<Shard*> shards;
+    Shard retired;
+};
+
+Registry& getRegistry() {
+    static Registry registry;
+    return registry;
+}
+
+// Sums 'shard' into 'total'
+void accumulate(Shard& total, const Shard& shard) {
+    for (size_t i = 0; i < k_numCounters; i++) {
+        increment(total.counters[i], shard.counters[i]);
+    }
+    for (size_t i = 0; i < k_numDropReasons; i++) {
+        increment(total.drops[i], shard.drops[i]);
+    }
+    for (size_t i = 0; i < k_numStages; i++) {
+        for (size_t j = 0; j < k_numBuckets; j++) {
+            increment(total.buckets[i][j], shard.buckets[i][j]);
+        }
+        increment(total.latencySum[i], shard.latencySum[i]);
+    }
+}
+
+/* Registers the thread's shard on first use and folds it into the retired
+ * totals when the thread exits
+ */
+class ShardHandle {
+public:
+    ShardHandle() {
+        Registry& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.shards.emplace_back(&m_shard);
+    }
+
+    ~ShardHandle() {
+        Registry& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        accumulate(registry.retired, m_shard);
+        for (auto i = registry.shards.begin(); i != registry.shards.end();
+             i++) {
+            if (*i == &m_shard) {
+                registry.shards.erase(i);
+                break;
+            }
+        }
+    }
+
+    Shard& get() { return m_shard; }
+
+private:
+    Shard m_shard;
+};
+
+Shard& getShard() {
+    thread_local ShardHandle handle;
+    return handle.get();
+}
+
+}  // namespace
+
+void Metrics::add(Counter counter, uint64_t value) {
+    increment(getShard().counters[static_cast<size_t>(counter)], value);
+}
+
+void Metrics::drop(DropReason reason) {
+    increment(getShard().drops[static_cast<size_t>(reason)], 1);
+}
+
+void Metrics::addLatency(Stage stage,
+                         std::chrono::steady_clock::duration duration) {
+    uint64_t ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+
+    size_t bucket = 0;
+    while (bucket < k_numBuckets - 1 && ns > k_bucketBounds[bucket] * 1000) {
+        bucket++;
+    }
+
+    Shard& shard = getShard();
+    increment(shard.buckets[static_cast<size_t>(stage)][bucket], 1);
+    increment(shard.latencySum[static_cast<size_t>(stage)], ns);
+}
+
+std::string Metrics::format() {
+    auto total = std::make_unique<Shard>();
+    {
+        Registry& registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        accumulate(*total, registry.retired);
+        for (auto shard : registry.shards) {
+            accumulate(*total, *shard);
+        }
+    }
+
+    std::stringstream ss;
+
+    for (size_t i = 0; i < k_numCounters; i++) {
+        ss << "# TYPE insight_" << k_counterNames[i] << "_total counter\n"
+           << "insight_" << k_counterNames[i] << "_total "
+           << total->counters[i] << "\n";
+    }
+
+    ss << "# TYPE insight_frames_dropped_total counter\n";
+    for (size_t i = 0; i < k_numDropReasons; i++) {
+        ss << "insight_frames_dropped_total{reason=\"" << k_dropReasonNames[i]
+           << "\"} " << total->drops[i] << "\n";
+    }
+
+    ss << "# TYPE insight_stage_latency_seconds histogram\n";
+    for (size_t i = 0; i < k_numStages; i++) {
+        uint64_t cumulative = 0;
+        for (size_t j = 0; j < k_numBuckets; j++) {
+            cumulative += total->buckets[i][j];
+            ss << "insight_stage_latency_seconds_bucket{stage=\""
+               << k_stageNames[i] << "\",le=\"";
+            if (j < k_numBuckets - 1) {
+                ss << k_bucketBounds[j] / 1e6;
+            } else {
+                ss << "+Inf";
+            }
+            ss << "\"} " << cumulative << "\n";
+        }
+        ss << "insight_stage_latency_seconds_sum{stage=\"" << k_stageNames[i]
+           << "\"} " << total->latencySum[i] / 1e9 << "\n"
+           << "insight_stage_latency_seconds_count{stage=\""
+           << k_stageNames[i] << "\"} " << cumulative << "\n";
+    }
+
+    return ss.str();
+}
@@ -0,0 +1,61 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+#include <string>
+
+/**
+ * Performance counters and latency histograms for the whole program
+ *
+ * Every thread records into its own set of counters, so recording a value
+ * never waits on or invalidates another thread's cache lines. The sets are
+ * only summed when format() is called.
+ */
+class Metrics {
+public:
+    enum class Counter {
+        framesReceived,
+        framesDecoded,
+        framesProcessed,
+        framesEncoded,
+        framesSent,
+        bytesEncoded,
+        bytesSent,
+        udpPacketsSent,
+        multicastPacketsSent,
+        h264FramesEncoded,
+        h264BytesEncoded,
+        rowsSkipped,
+        duplicatesSkipped,
+        count
+    };
+
+    enum class DropReason {
+        decodeFailed,
+        displayRate,
+        sendFailed,
+        unchanged,
+        rateLimited,
+        clientBehind,
+        incompleteFrame,
+        count
+    };
+
+    enum class Stage { decode, process, encode, h264Encode, send, count };
+
+    // Adds 'value' to the given counter
+    static void add(Counter counter, uint64_t value = 1);
+
+    // Counts a frame dropped for the given reason
+    static void drop(DropReason reason);
+
+    // Records how long one frame spent in the given stage
+    static void addLatency(Stage stage,
+                           std::chrono::steady_clock::duration duration);
+
+    // Returns every metric in the Prometheus text exposition format
+    static std::string format();
+};
@@ -0,0 +1,90 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(unsigned int numThreads) {
+    if (numThreads == 0) {
+        numThreads = std::thread::hardware_concurrency();
+    }
+
+    // The thread calling parallelFor() does work too
+    for (unsigned int i = 1; i < numThreads; i++) {
+        m_threads.emplace_back(&ThreadPool::workerFunc, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isRunning = false;
+    }
+    m_jobReady.notify_all();
+
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+unsigned int ThreadPool::size() const { return m_threads.size() + 1; }
+
+void ThreadPool::parallelFor(unsigned int count,
+                             const std::function<void(unsigned int)>& func) {
+    if (count == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> callLock(m_callMutex);
+
+    // Run small batches inline rather than waking the workers
+    if (count == 1 || m_threads.size() == 0) {
+        for (unsigned int i = 0; i < count; i++) {
+            func(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_func = &func;
+        m_count = count;
+        m_next = 0;
+        m_pending = m_threads.size();
+        m_batch++;
+    }
+    m_jobReady.notify_all();
+
+    runJobs();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_jobDone.wait(lock, [this] { return m_pending == 0; });
+    m_func = nullptr;
+}
+
+void ThreadPool::runJobs() {
+    for (unsigned int i = m_next++; i < m_count; i = m_next++) {
+        (*m_func)(i);
+    }
+}
+
+void ThreadPool::workerFunc() {
+    uint64_t lastBatch = 0;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_jobReady.wait(
+            lock, [&] { return !m_isRunning || m_batch != lastBatch; });
+        if (!m_isRunning) {
+            return;
+        }
+        lastBatch = m_batch;
+
+        lock.unlock();
+        runJobs();
+        lock.lock();
+
+        m_pending--;
+        if (m_pending == 0) {
+            m_jobDone.notify_one();
+        }
+    }
+}
@@ -0,0 +1,61 @@
+// Copyright (c) 2013-2018 FRC Team 3512. All Rights Reserved.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of worker threads which run batches of indexed jobs
+ */
+class ThreadPool {
+public:
+    // A thread count of 0 uses one thread per hardware core
+    explicit ThreadPool(unsigned int numThreads = 0);
+    virtual ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Returns number of threads jobs are spread across (including the caller)
+    unsigned int size() const;
+
+    /* Calls func(i) for every i in [0, count) and blocks until all of them
+     * have returned. The calling thread runs jobs alongside the workers.
+     */
+    void parallelFor(unsigned int count,
+                     const std::function<void(unsigned int)>& func);
+
+private:
+    std::vector<std::thread> m_threads;
+
+    // Serializes callers of parallelFor()
+    std::mutex m_callMutex;
+
+    std::mutex m_mutex;
+    std::condition_variable m_jobReady;
+    std::condition_variable m_jobDone;
+
+    const std::function<void(unsigned int)>* m_func = nullptr;
+    unsigned int m_count = 0;
+    std::atomic<unsigned int> m_next{0};
+
+    // Number of workers which haven't finished the current batch
+    unsigned int m_pending = 0;
+
+    // Incremented each time a new batch is posted
+    uint64_t m_batch = 0;
+
+    bool m_isRunning = true;
+
+    void runJobs();
+
+    // Function is used by m_threads
+    void workerFunc();
+};